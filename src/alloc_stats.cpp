@@ -0,0 +1,49 @@
+#include <new>
+#include <atomic>
+#include <cstdlib>
+
+#include <alloc_stats.h>
+
+static std::atomic<size_t> alloc_count(0);
+
+size_t num_allocs() {
+    return alloc_count.load(std::memory_order_relaxed);
+}
+
+void* operator new(size_t size) {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    void* p = std::malloc(size);
+    if (!p) throw std::bad_alloc();
+    return p;
+}
+
+void* operator new[](size_t size) {
+    return operator new(size);
+}
+
+void* operator new(size_t size, const std::nothrow_t&) noexcept {
+    alloc_count.fetch_add(1, std::memory_order_relaxed);
+    if (size == 0) size = 1;
+    return std::malloc(size);
+}
+
+void* operator new[](size_t size, const std::nothrow_t& nt) noexcept {
+    return operator new(size, nt);
+}
+
+void operator delete(void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p) noexcept {
+    std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+    std::free(p);
+}
+
+void operator delete[](void* p, size_t) noexcept {
+    std::free(p);
+}
@@ -0,0 +1,9 @@
+#ifndef __ALLOC_STATS_H__
+#define __ALLOC_STATS_H__
+
+#include <cstddef>
+
+//  total number of the heap allocations made through the global operator new so far
+size_t num_allocs();
+
+#endif
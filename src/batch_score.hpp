@@ -0,0 +1,296 @@
+#ifndef __BATCH_SCORE__
+#define __BATCH_SCORE__
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+#include <limits>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+#include <shape_library.hpp>
+#include <bitboard.hpp>
+#include <pair_table.hpp>
+#include <fixed_shape.hpp>
+
+//  a block of candidate layouts in the structure-of-arrays form:
+//  the i-th position of the k-th candidate is at [i*capacity + k]
+struct layout_block {
+    int nshapes, capacity;
+    std::vector<int> x, y;
+    std::vector<uint16_t> shape_idx, var_idx;
+
+    layout_block() : nshapes(0), capacity(0) {}
+
+    void resize(int _nshapes, int _capacity) {
+        nshapes = _nshapes;
+        capacity = _capacity;
+        const size_t n = (size_t)nshapes*capacity;
+        x.resize(n);
+        y.resize(n);
+        shape_idx.resize(n);
+        var_idx.resize(n);
+    }
+
+    void set(int k, const_layout_ref positions) {
+        for (int i = 0; i < nshapes; i++) {
+            const shape_pos& pos = positions[i];
+            const int j = i*capacity + k;
+            x[j] = pos.x;
+            y[j] = pos.y;
+            shape_idx[j] = pos.shape_idx;
+            var_idx[j] = pos.var_idx;
+        }
+    }
+
+    void set(int k, int i, const shape_pos& pos) {
+        const int j = i*capacity + k;
+        x[j] = pos.x;
+        y[j] = pos.y;
+        shape_idx[j] = pos.shape_idx;
+        var_idx[j] = pos.var_idx;
+    }
+
+    void get(int k, std::vector<shape_pos>& positions) const {
+        positions.resize(nshapes);
+        for (int i = 0; i < nshapes; i++) {
+            const int j = i*capacity + k;
+            positions[i] = shape_pos::at({x[j], y[j]}, shape_idx[j], var_idx[j]);
+        }
+    }
+};
+
+//  scores the blocks of candidates, gives the same results as shape::score:
+//  the bounds are computed for the whole block at once, and the candidates
+//  are rasterized and flood-filled by LANES at a time, one 64-bit row word per lane
+class batch_scorer {
+public:
+    static const int LANES = 4;
+    typedef uint64_t word;
+
+    //  the variants' extents and row masks come from the library, by the global variant id
+    batch_scorer(const shape_library& _lib, const pair_table* _table = nullptr,
+        area_method _method = area_method::FloodFill) :
+        lib(_lib), table(_table), method(_method) {}
+
+    void reserve(int nshapes, int capacity, int max_height) {
+        var_id.reserve((size_t)nshapes*capacity);
+        lt_x.reserve(capacity);
+        lt_y.reserve(capacity);
+        rb_x.reserve(capacity);
+        rb_y.reserve(capacity);
+        area.reserve(capacity);
+        lanes_reserve(max_height + lib.get_order());
+        positions.reserve(nshapes);
+        scratch.reserve(max_height, max_height);
+    }
+
+    //  scores the first n candidates of the block
+    void score(const layout_block& block, int n, double* scores) {
+        const int nshapes = block.nshapes;
+        const int cap = block.capacity;
+
+        //  global variant ids
+        var_id.resize((size_t)nshapes*cap);
+        for (int i = 0; i < nshapes; i++) {
+            const uint16_t* sidx = &block.shape_idx[i*cap];
+            const uint16_t* vidx = &block.var_idx[i*cap];
+            int* vid = &var_id[i*cap];
+            for (int k = 0; k < n; k++) vid[k] = lib.get_var_offset(sidx[k]) + vidx[k];
+        }
+
+        //  bounds of all the candidates
+        lt_x.assign(n, std::numeric_limits<int>::max());
+        lt_y.assign(n, std::numeric_limits<int>::max());
+        rb_x.assign(n, std::numeric_limits<int>::min());
+        rb_y.assign(n, std::numeric_limits<int>::min());
+        for (int i = 0; i < nshapes; i++) {
+            const int* px = &block.x[i*cap];
+            const int* py = &block.y[i*cap];
+            const int* vid = &var_id[i*cap];
+            for (int k = 0; k < n; k++) {
+                lt_x[k] = std::min(lt_x[k], px[k]);
+                lt_y[k] = std::min(lt_y[k], py[k]);
+                const shape_library::variant& v = lib.get(vid[k]);
+                rb_x[k] = std::max(rb_x[k], px[k] + v.width);
+                rb_y[k] = std::max(rb_y[k], py[k] + v.height);
+            }
+        }
+
+        //  enclosed areas
+        area.resize(n);
+        if (method == area_method::FloodFill) {
+            dispatch_order(lib.get_order(), [&](auto order) {
+                for (int k = 0; k < n; k += LANES) fill_lanes<decltype(order)::value>(block, k, std::min(LANES, n - k));
+            });
+        } else {
+            for (int k = 0; k < n; k++) {
+                block.get(k, positions);
+                area[k] = lib.contour_area(positions);
+            }
+        }
+
+        //  the gaps between the ring neighbours, for the ones that are not closed
+        for (int k = 0; k < n; k++) {
+            if (area[k] > 0) {
+                scores[k] = area[k];
+                continue;
+            }
+            int dist = 0;
+            for (int i = 0; i < nshapes; i++) {
+                const int j1 = i*cap + k;
+                const int j2 = ((i + 1)%nshapes)*cap + k;
+                shape_pos pos1 = shape_pos::at({block.x[j1], block.y[j1]}, block.shape_idx[j1], block.var_idx[j1]);
+                shape_pos pos2 = shape_pos::at({block.x[j2], block.y[j2]}, block.shape_idx[j2], block.var_idx[j2]);
+                dist += abs(table ? (*table)(pos1, pos2) : shape::direct_distance{lib.get_variations()}(pos1, pos2));
+            }
+            scores[k] = -dist;
+        }
+    }
+
+private:
+    const shape_library& lib;
+    const pair_table* table;
+    area_method method;
+
+    std::vector<int> var_id;
+    std::vector<int> lt_x, lt_y, rb_x, rb_y;
+    std::vector<int> area;
+
+    //  the lane-interleaved boards: [row*LANES + lane], with a guard row above and below,
+    //  and the room for the empty row masks of the same-order sets (see shape_library) below that
+    std::vector<word> occ, region, border;
+
+    //  for the candidates that don't fit into the lanes
+    std::vector<shape_pos> positions;
+    bitboard scratch;
+
+    void lanes_reserve(int h) {
+        const size_t n = (size_t)(h + 2)*LANES;
+        if (occ.size() < n) {
+            occ.resize(n);
+            region.resize(n);
+            border.resize(n);
+        }
+    }
+
+    //  computes the flood_fill results for the candidates [k0, k0 + nlanes),
+    //  N is the shapes' order if it's specialized (see dispatch_order), 0 otherwise
+    template <int N>
+    void fill_lanes(const layout_block& block, int k0, int nlanes) {
+        const int cap = block.capacity;
+        int w[LANES], h[LANES];
+        bool active[LANES];
+        int max_h = 0;
+        for (int l = 0; l < LANES; l++) {
+            const int k = k0 + l;
+            active[l] = false;
+            if (l >= nlanes) continue;
+            w[l] = rb_x[k] - lt_x[k] + 1;
+            h[l] = rb_y[k] - lt_y[k] + 1;
+            if (w[l] > bitboard::WORD_BITS) {
+                //  too wide, score it on its own
+                block.get(k, positions);
+                area[k] = lib.flood_fill(positions, scratch);
+                continue;
+            }
+            active[l] = true;
+            max_h = std::max(max_h, h[l]);
+        }
+        if (max_h == 0) return;
+
+        //  everything outside of the candidate's own bounds counts as occupied,
+        //  so the fill leaks when it touches the bounds' border
+        const int nrows = max_h + 2;
+        lanes_reserve(max_h + N);
+        for (int y = 0; y < nrows; y++) {
+            for (int l = 0; l < LANES; l++) {
+                const int j = y*LANES + l;
+                region[j] = 0;
+                border[j] = 0;
+                occ[j] = ~word(0);
+                if (!active[l] || y == 0 || y > h[l]) continue;
+                const word inside = (w[l] == bitboard::WORD_BITS) ? ~word(0) : ((word(1) << w[l]) - 1);
+                occ[j] = ~inside;
+                border[j] = (y == 1 || y == h[l]) ? inside : (word(1) | (word(1) << (w[l] - 1)));
+            }
+        }
+
+        //  rasterize
+        for (int l = 0; l < LANES; l++) {
+            if (!active[l]) continue;
+            const int k = k0 + l;
+            for (int i = 0; i < block.nshapes; i++) {
+                const int j = i*cap + k;
+                const int vid = var_id[j];
+                const int x = block.x[j] - lt_x[k];
+                const int y = block.y[j] - lt_y[k];
+                const shape_library::variant& v = lib.get(vid);
+                const word* bits = lib.rows(v);
+                for (int r = 0; r < lib.num_rows<N>(v); r++) occ[(y + r + 1)*LANES + l] |= bits[r] << x;
+            }
+        }
+
+        //  starting points, same as in shape::flood_fill
+        for (int l = 0; l < LANES; l++) {
+            if (!active[l]) continue;
+            auto is_set = [&](int x, int y) {
+                if (x < 0 || y < 0 || x >= w[l] || y >= h[l]) return true;
+                return ((occ[(y + 1)*LANES + l] >> x) & 1) != 0;
+            };
+            vec2i start{w[l]/2, h[l]/2};
+            if (is_set(start.x, start.y)) {
+                for (const vec2i& offs : COFFS) {
+                    vec2i c = start + offs;
+                    if (!is_set(c.x, c.y)) {
+                        start = c;
+                        break;
+                    }
+                }
+            }
+            region[(start.y + 1)*LANES + l] = word(1) << start.x;
+        }
+
+        //  alternating dilation sweeps over all the lanes at once
+        word leaked[LANES] = {0};
+        bool forward = true;
+        while (true) {
+            word diff[LANES] = {0};
+            for (int i = 1; i <= max_h; i++) {
+                const int y = forward ? i : max_h + 1 - i;
+                word* cur = &region[y*LANES];
+                const word* up = cur - LANES;
+                const word* down = cur + LANES;
+                const word* o = &occ[y*LANES];
+                const word* b = &border[y*LANES];
+                for (int l = 0; l < LANES; l++) {
+                    word v = cur[l] | up[l] | down[l];
+                    v |= (v << 1) | (v >> 1);
+                    word res = cur[l] | (v & ~o[l]);
+                    diff[l] |= res ^ cur[l];
+                    leaked[l] |= res & b[l];
+                    cur[l] = res;
+                }
+            }
+            bool done = true;
+            for (int l = 0; l < LANES; l++) {
+                if (active[l] && diff[l] && !leaked[l]) done = false;
+            }
+            if (done) break;
+            forward = !forward;
+        }
+
+        for (int l = 0; l < LANES; l++) {
+            if (!active[l]) continue;
+            int res = -1;
+            if (!leaked[l]) {
+                res = 0;
+                for (int y = 1; y <= h[l]; y++) res += popcount64(region[y*LANES + l]);
+            }
+            area[k0 + l] = res;
+        }
+    }
+};
+
+#endif // __BATCH_SCORE__
@@ -0,0 +1,237 @@
+#ifndef __BITBOARD__
+#define __BITBOARD__
+
+#include <vector>
+#include <algorithm>
+#include <cstdint>
+
+#if defined(_MSC_VER)
+#include <intrin.h>
+#endif
+
+//  the x64 builds have the AVX2 sweep too, picked at runtime where the CPU has it
+#if defined(_M_X64) || defined(__x86_64__)
+#define BITBOARD_AVX2
+#endif
+
+inline int popcount64(uint64_t x) {
+#if defined(_MSC_VER) && defined(_M_X64)
+    return (int)__popcnt64(x);
+#elif defined(__GNUC__)
+    return __builtin_popcountll(x);
+#else
+    x = x - ((x >> 1) & 0x5555555555555555ULL);
+    x = (x & 0x3333333333333333ULL) + ((x >> 2) & 0x3333333333333333ULL);
+    x = (x + (x >> 4)) & 0x0F0F0F0F0F0F0F0FULL;
+    return (int)((x*0x0101010101010101ULL) >> 56);
+#endif
+}
+
+#if defined(BITBOARD_AVX2)
+//  checks if the CPU (and the OS, which has to save the ymm registers) supports AVX2
+inline bool cpu_has_avx2() {
+#if defined(_MSC_VER)
+    int info[4];
+    __cpuid(info, 0);
+    if (info[0] < 7) return false;
+    __cpuid(info, 1);
+    const bool osxsave = (info[2] & (1 << 27)) != 0;
+    const bool avx = (info[2] & (1 << 28)) != 0;
+    if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) return false;
+    __cpuidex(info, 7, 0);
+    return (info[1] & (1 << 5)) != 0;
+#else
+    return __builtin_cpu_supports("avx2");
+#endif
+}
+
+//  bitboard's sweep1 processing 4 rows at a time, lives in bitboard_avx2.cpp,
+//  the only code that gets built for AVX2 (so the rest runs on any x64 CPU)
+bool sweep1_avx2(uint64_t* region, const uint64_t* cells, int num_rows, bool forward);
+#endif
+
+//  bit-packed occupancy grid with the 8-connected flood fill on top of it,
+//  every row is a run of 64-bit words (bit i of the word k is column k*64 + i)
+class bitboard {
+public:
+    typedef uint64_t word;
+    static const int WORD_BITS = 64;
+
+    //  rows are processed by 4 at a time in the AVX2 path,
+    //  plus there is a guard row above and below the board
+    static const int ROW_ALIGN = 4;
+    static_assert(ROW_ALIGN*sizeof(word) == 32, "sweep1_avx2 takes the rows by 4");
+
+    int width, height, stride;
+
+    bitboard() : width(0), height(0), stride(0), num_rows(0), use_avx2(has_avx2()) {}
+
+    //  the AVX2 sweep gets used where the CPU has it, unless turned off here
+    void set_avx2(bool enable) { use_avx2 = enable && has_avx2(); }
+    bool uses_avx2() const { return use_avx2; }
+
+    static bool has_avx2() {
+#if defined(BITBOARD_AVX2)
+        static const bool res = cpu_has_avx2();
+        return res;
+#else
+        return false;
+#endif
+    }
+
+    //  preallocates the storage for boards up to the given size
+    void reserve(int w, int h) {
+        const size_t nwords = storage_size(w, h);
+        if (cells.size() < nwords) {
+            cells.resize(nwords);
+            region.resize(nwords);
+        }
+    }
+
+    //  clears the board and makes it of the given size,
+    //  keeping the allocated storage if it's big enough
+    void reset(int w, int h) {
+        width = w;
+        height = h;
+        stride = (w + WORD_BITS - 1)/WORD_BITS;
+        num_rows = (h + ROW_ALIGN - 1)/ROW_ALIGN*ROW_ALIGN + 2;
+        const size_t nwords = (size_t)num_rows*stride;
+        reserve(w, h);
+
+        //  everything outside of the board is "occupied", so the fill never gets there
+        const int tail_bits = w%WORD_BITS;
+        const word tail_mask = tail_bits ? (~word(0) << tail_bits) : 0;
+        for (int y = 0; y < num_rows; y++) {
+            word* row = &cells[y*stride];
+            const bool inside = (y > 0 && y <= h);
+            for (int k = 0; k < stride; k++) row[k] = inside ? 0 : ~word(0);
+            if (inside) row[stride - 1] |= tail_mask;
+        }
+        std::fill(region.begin(), region.begin() + nwords, word(0));
+    }
+
+    inline bool is_set(int x, int y) const {
+        if (x < 0 || y < 0 || x >= width || y >= height) return true;
+        return (cells[(y + 1)*stride + x/WORD_BITS] >> (x%WORD_BITS)) & 1;
+    }
+
+    inline void set(int x, int y) {
+        cells[(y + 1)*stride + x/WORD_BITS] |= word(1) << (x%WORD_BITS);
+    }
+
+    inline void clear(int x, int y) {
+        cells[(y + 1)*stride + x/WORD_BITS] &= ~(word(1) << (x%WORD_BITS));
+    }
+
+    //  flood-fills the free space 8-connected to the (x, y) cell
+    //  (the starting cell is counted even if occupied),
+    //  returns the number of filled cells or -1 if the filled area touches the board's border
+    int fill(int x, int y) {
+        std::fill(region.begin(), region.begin() + num_rows*stride, word(0));
+        region[(y + 1)*stride + x/WORD_BITS] |= word(1) << (x%WORD_BITS);
+
+        //  grow the region by alternating top-down and bottom-up dilation sweeps,
+        //  until it either stops changing or leaks to the border
+        bool forward = true;
+        while (true) {
+            bool changed = (stride == 1) ? sweep1(forward) : sweep(forward);
+            if (touches_border()) return -1;
+            if (!changed) break;
+            forward = !forward;
+        }
+
+        int res = 0;
+        for (int y = 1; y <= height; y++) {
+            const word* row = &region[y*stride];
+            for (int k = 0; k < stride; k++) res += popcount64(row[k]);
+        }
+        return res;
+    }
+
+    //  calls fn(x, y) for every cell of the last filled region
+    template <typename TFn>
+    void for_each_filled(TFn fn) const {
+        for (int y = 0; y < height; y++) {
+            const word* row = &region[(y + 1)*stride];
+            for (int k = 0; k < stride; k++) {
+                word w = row[k];
+                for (int b = 0; w != 0; b++, w >>= 1) {
+                    if (w & 1) fn(k*WORD_BITS + b, y);
+                }
+            }
+        }
+    }
+
+private:
+    int num_rows;
+    bool use_avx2;
+    std::vector<word> cells;
+    std::vector<word> region;
+
+    static size_t storage_size(int w, int h) {
+        const size_t nwords = (w + WORD_BITS - 1)/WORD_BITS;
+        return ((h + ROW_ALIGN - 1)/ROW_ALIGN*ROW_ALIGN + 2)*nwords;
+    }
+
+    bool touches_border() const {
+        const word* top = &region[stride];
+        const word* bottom = &region[height*stride];
+        for (int k = 0; k < stride; k++) {
+            if (top[k] | bottom[k]) return true;
+        }
+        const int last = width - 1;
+        const word left_bit = 1;
+        const word right_bit = word(1) << (last%WORD_BITS);
+        for (int y = 1; y <= height; y++) {
+            const word* row = &region[y*stride];
+            if ((row[0] & left_bit) || (row[last/WORD_BITS] & right_bit)) return true;
+        }
+        return false;
+    }
+
+    //  one dilation sweep for boards that fit into a single word per row
+    bool sweep1(bool forward) {
+        word* r = region.data();
+        const word* c = cells.data();
+#if defined(BITBOARD_AVX2)
+        if (use_avx2) return sweep1_avx2(r, c, num_rows, forward);
+#endif
+        word diff = 0;
+        for (int i = 0; i < height; i++) {
+            const int y = 1 + (forward ? i : height - 1 - i);
+            word v = r[y] | r[y - 1] | r[y + 1];
+            v |= (v << 1) | (v >> 1);
+            word res = r[y] | (v & ~c[y]);
+            diff |= res ^ r[y];
+            r[y] = res;
+        }
+        return diff != 0;
+    }
+
+    //  generic dilation sweep, carrying the bits over the word boundaries
+    bool sweep(bool forward) {
+        word diff = 0;
+        for (int i = 0; i < height; i++) {
+            const int y = 1 + (forward ? i : height - 1 - i);
+            word* cur = &region[y*stride];
+            const word* up = cur - stride;
+            const word* down = cur + stride;
+            const word* occ = &cells[y*stride];
+            word prev_v = 0;
+            word v = cur[0] | up[0] | down[0];
+            for (int k = 0; k < stride; k++) {
+                word next_v = (k + 1 < stride) ? (cur[k + 1] | up[k + 1] | down[k + 1]) : 0;
+                word d = v | (v << 1) | (v >> 1) |
+                    (prev_v >> (WORD_BITS - 1)) | (next_v << (WORD_BITS - 1));
+                word res = cur[k] | (d & ~occ[k]);
+                diff |= res ^ cur[k];
+                cur[k] = res;
+                prev_v = v;
+                v = next_v;
+            }
+        }
+        return diff != 0;
+    }
+};
+
+#endif // __BITBOARD__
@@ -0,0 +1,30 @@
+//  bitboard's sweep1 for the CPUs with AVX2, see bitboard.hpp. This file gets built for AVX2 (the function's
+//  target here, the file's instruction set in the project), and is only called when cpu_has_avx2() says so.
+//  It doesn't include bitboard.hpp on purpose: the inline functions from there would get the AVX2 code too,
+//  and the linker could pick those copies for the whole program.
+#include <cstdint>
+
+#if defined(_M_X64) || defined(__x86_64__)
+#include <immintrin.h>
+
+#if defined(__GNUC__)
+__attribute__((target("avx2")))
+#endif
+bool sweep1_avx2(uint64_t* r, const uint64_t* c, int num_rows, bool forward) {
+    const int align = 4;    //  bitboard::ROW_ALIGN, the rows in a __m256i
+    __m256i vdiff = _mm256_setzero_si256();
+    for (int i = 0; i < num_rows - 2; i += align) {
+        const int y = 1 + (forward ? i : num_rows - 2 - align - i);
+        __m256i cur  = _mm256_loadu_si256((const __m256i*)(r + y));
+        __m256i up   = _mm256_loadu_si256((const __m256i*)(r + y - 1));
+        __m256i down = _mm256_loadu_si256((const __m256i*)(r + y + 1));
+        __m256i occ  = _mm256_loadu_si256((const __m256i*)(c + y));
+        __m256i v = _mm256_or_si256(cur, _mm256_or_si256(up, down));
+        v = _mm256_or_si256(v, _mm256_or_si256(_mm256_slli_epi64(v, 1), _mm256_srli_epi64(v, 1)));
+        __m256i res = _mm256_or_si256(cur, _mm256_andnot_si256(occ, v));
+        vdiff = _mm256_or_si256(vdiff, _mm256_xor_si256(res, cur));
+        _mm256_storeu_si256((__m256i*)(r + y), res);
+    }
+    return !_mm256_testz_si256(vdiff, vdiff);
+}
+#endif
@@ -0,0 +1,320 @@
+#ifndef __BRANCH_BOUND__
+#define __BRANCH_BOUND__
+
+#include <vector>
+#include <atomic>
+#include <mutex>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <algorithm>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+#include <bitboard.hpp>
+#include <task_pool.hpp>
+#include <run_control.hpp>
+
+//  exact search for the best closed ring, for the small shape sets.
+//  The shapes get placed around the ring one by one, each next one touching the previous one
+//  by an edge and not overlapping any of the placed ones, with the last one closing the ring.
+//  The branches are cut off when:
+//   - the remaining shapes can't reach back to the first one anymore;
+//   - the area bound can't beat the best ring found so far: the hole's perimeter plus the outer
+//     perimeter can't exceed the total perimeter of the shapes (minus two edges for every touching
+//     pair of edges, and there is at least one of those per remaining ring link), and the outer
+//     contour goes around the hole's bounding box, so area <= ((perimeter - 8)/8)^2;
+//   - the layout is a copy of an already visited one: the ring starts from a fixed shape, in a fixed
+//     variant (the variants are all the rotations/reflections, so every layout can be turned that way)
+//     and at a fixed position, it goes in the direction of the smaller shape index of the two neighbours,
+//     and the identical shapes appear along the ring in the order of their indices.
+//  The branches after the first link are farmed out to the thread pool, sharing the best score.
+//  The search stops early on SIGINT/SIGTERM (see run_controller::catch_signals()), when out of the controller's
+//  time budget or after the given number of nodes, leaving the best ring found so far, not proven to be the best.
+class branch_bound {
+public:
+    explicit branch_bound(const shape::variation_array& _variations) :
+        variations(_variations), n((int)_variations.size()), best_area(0), reason((int)stop_reason::None), num_nodes(0), ms(0)
+    {
+        //  the shape with the most variants goes first, as fixing its variant cuts off the most copies
+        first = 0;
+        for (int i = 1; i < n; i++) {
+            if (variations[i].size() > variations[first].size()) first = i;
+        }
+
+        int ext = 0;
+        total_perimeter = 0;
+        for (int i = 0; i < n; i++) {
+            const shape& sh = variations[i][0];
+            ext += std::max(sh.width, sh.height);
+
+            int perimeter = 0, diam = 0;
+            for (const auto& sq : sh.squares) {
+                for (const auto& offs : OFFS) perimeter += sh.is_set(sq.x + offs.x, sq.y + offs.y) ? 0 : 1;
+                for (const auto& sq2 : sh.squares) diam = std::max(diam, abs(sq.x - sq2.x) + abs(sq.y - sq2.y));
+            }
+            total_perimeter += perimeter;
+            reach.push_back(diam + 1);
+
+            int tw = i;
+            for (int k = 0; k < i && tw == i; k++) {
+                if (std::find(variations[k].begin(), variations[k].end(), sh) != variations[k].end()) tw = k;
+            }
+            twin.push_back(tw);
+        }
+
+        //  the ring can't get further from the first shape than all the shapes put in a row
+        side = 2*ext + 8;
+    }
+
+    branch_bound(const branch_bound&) = delete;
+    branch_bound& operator =(const branch_bound&) = delete;
+
+    //  searches through all the rings, returns false if none of them encloses anything
+    //  (or none was found before the search got stopped, see proven()), max_nodes of 0 means no limit
+    bool run(task_pool& pool, const run_controller* ctl = nullptr, size_t max_nodes = 0) {
+        using namespace std::chrono;
+        high_resolution_clock::time_point start_time = high_resolution_clock::now();
+
+        best_area = 0;
+        reason = (int)stop_reason::None;
+        controller = ctl;
+        node_budget = max_nodes;
+        nodes_spent = 0;
+        num_nodes = 0;
+        best.clear();
+
+        std::vector<worker_state> states(pool.size());
+        for (auto& st : states) init_state(st);
+
+        worker_state& root = states[0];
+        place_first(root);
+        std::vector<shape_pos> links;
+        if (n > 1) {
+            add_candidates(root, 1, root.cands[1]);
+            links = root.cands[1];
+        }
+        root.nodes++;
+        pool.parallel_for((int)links.size(), [&](int i, int worker) {
+            worker_state& st = states[worker];
+            if (st.ring.empty()) place_first(st);
+            descend(st, 1, links[i]);
+        });
+
+        for (const auto& st : states) num_nodes += st.nodes;
+        ms = (int)duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count();
+        if (!best.empty()) shape::center(variations, best);
+        return !best.empty();
+    }
+
+    //  whether the whole search space got searched, so the best ring is the optimum
+    bool proven() const { return get_reason() == stop_reason::None; }
+
+    //  why the search stopped early, None if it didn't
+    stop_reason get_reason() const { return (stop_reason)reason.load(); }
+
+    double best_score() const { return best_area; }
+    const std::vector<shape_pos>& get_best() const { return best; }
+    size_t get_num_nodes() const { return num_nodes; }
+    int get_ms() const { return ms; }
+
+private:
+    //  how often the workers check whether to stop, in the nodes, a power of two
+    static const size_t CHECK_NODES = 4096;
+
+    struct worker_state {
+        std::vector<uint8_t> grid;      //  side*side cells, which ones are taken
+        std::vector<shape_pos> ring;    //  the shapes placed so far
+        std::vector<uint8_t> used;
+        std::vector<std::vector<shape_pos>> cands;     //  the placements to try, per ring index
+        int shared;                     //  the touching edges between the placed shapes
+        int remaining_reach;            //  sum of reach[] over the shapes not placed yet
+        bitboard board;
+        size_t nodes;
+    };
+
+    const shape::variation_array& variations;
+    int n;
+    int first;
+    int side;
+    int total_perimeter;
+    std::vector<int> reach;     //  max manhattan distance between two squares of the shape, plus one
+    std::vector<int> twin;      //  the first shape identical to the given one
+
+    std::atomic<int> best_area;
+    std::atomic<int> reason;            //  stop_reason, the first one to stop the search
+    const run_controller* controller;
+    size_t node_budget;
+    std::atomic<size_t> nodes_spent;    //  counted by CHECK_NODES at a time
+    std::mutex best_lock;
+    std::vector<shape_pos> best;
+    size_t num_nodes;
+    int ms;
+
+    const shape& get_shape(const shape_pos& pos) const { return variations[pos.shape_idx][pos.var_idx]; }
+
+    void init_state(worker_state& st) const {
+        st.grid.assign(side*side, 0);
+        st.ring.clear();
+        st.ring.reserve(n);
+        st.used.assign(n, 0);
+        st.cands.resize(n + 1);
+        st.shared = 0;
+        st.remaining_reach = 0;
+        for (int i = 0; i < n; i++) st.remaining_reach += reach[i];
+        st.nodes = 0;
+    }
+
+    void place_first(worker_state& st) const {
+        const shape& sh = variations[first][0];
+        shape_pos pos = shape_pos::at({(side - sh.width)/2, (side - sh.height)/2}, first, 0);
+        place(st, pos);
+    }
+
+    bool fits(const worker_state& st, const shape_pos& pos) const {
+        const shape& sh = get_shape(pos);
+        if (pos.x < 1 || pos.y < 1 || pos.x + sh.width >= side || pos.y + sh.height >= side) return false;
+        for (const auto& sq : sh.squares) {
+            if (st.grid[(pos.y + sq.y)*side + pos.x + sq.x]) return false;
+        }
+        return true;
+    }
+
+    //  returns the number of the edges touching the already placed shapes
+    int place(worker_state& st, const shape_pos& pos) const {
+        const shape& sh = get_shape(pos);
+        int shared = 0;
+        for (const auto& sq : sh.squares) {
+            const int c = (pos.y + sq.y)*side + pos.x + sq.x;
+            shared += st.grid[c - 1] + st.grid[c + 1] + st.grid[c - side] + st.grid[c + side];
+        }
+        for (const auto& sq : sh.squares) st.grid[(pos.y + sq.y)*side + pos.x + sq.x] = 1;
+        st.ring.push_back(pos);
+        st.used[pos.shape_idx] = 1;
+        st.shared += shared;
+        st.remaining_reach -= reach[pos.shape_idx];
+        return shared;
+    }
+
+    void unplace(worker_state& st, int shared) const {
+        const shape_pos pos = st.ring.back();
+        const shape& sh = get_shape(pos);
+        for (const auto& sq : sh.squares) st.grid[(pos.y + sq.y)*side + pos.x + sq.x] = 0;
+        st.ring.pop_back();
+        st.used[pos.shape_idx] = 0;
+        st.shared -= shared;
+        st.remaining_reach += reach[pos.shape_idx];
+    }
+
+    //  whether the shape can go to the given ring index, as far as the symmetries go
+    bool allowed(const worker_state& st, int idx, int s) const {
+        if (st.used[s]) return false;
+        for (int k = twin[s]; k < s; k++) {
+            if (twin[k] == twin[s] && !st.used[k]) return false;
+        }
+        return idx < n - 1 || n < 3 || s > st.ring[1].shape_idx;
+    }
+
+    //  all the placements for the ring index, touching the previous shape
+    void add_candidates(const worker_state& st, int idx, std::vector<shape_pos>& res) const {
+        res.clear();
+        const shape_pos& prev = st.ring[idx - 1];
+        for (const auto& psq : get_shape(prev).squares) {
+            for (const auto& offs : OFFS) {
+                const vec2i b = prev.p() + psq + offs;
+                if (st.grid[b.y*side + b.x]) continue;
+                for (int s = 0; s < n; s++) {
+                    if (!allowed(st, idx, s)) continue;
+                    const auto& vars = variations[s];
+                    for (int v = 0; v < (int)vars.size(); v++) {
+                        for (const auto& sq : vars[v].squares) {
+                            shape_pos pos = shape_pos::at(b - sq, s, v);
+                            if (fits(st, pos)) res.push_back(pos);
+                        }
+                    }
+                }
+            }
+        }
+        std::sort(res.begin(), res.end(), [](const shape_pos& a, const shape_pos& b) {
+            if (a.shape_idx != b.shape_idx) return a.shape_idx < b.shape_idx;
+            if (a.var_idx != b.var_idx) return a.var_idx < b.var_idx;
+            return a.y == b.y ? a.x < b.x : a.y < b.y;
+        });
+        res.erase(std::unique(res.begin(), res.end()), res.end());
+    }
+
+    //  places the shape at the ring index and searches on from there
+    void descend(worker_state& st, int idx, const shape_pos& pos) {
+        if (reason.load(std::memory_order_relaxed) != (int)stop_reason::None) return;
+        const int shared = place(st, pos);
+        st.nodes++;
+        if ((st.nodes & (CHECK_NODES - 1)) == 0) check_stop();
+
+        //  can the rest still close the ring
+        const int d = distance(get_shape(pos), pos.p(), get_shape(st.ring[0]), st.ring[0].p());
+        const bool last = (idx == n - 1);
+        bool ok = last ? (d == 0) : (d <= st.remaining_reach);
+
+        //  can it still beat the best one
+        if (ok) {
+            const int links_left = last ? 0 : n - idx;
+            const int perimeter = total_perimeter - 2*st.shared - 2*links_left;
+            ok = area_bound(perimeter) > best_area.load(std::memory_order_relaxed);
+        }
+
+        if (ok) {
+            if (last) {
+                evaluate(st);
+            } else {
+                std::vector<shape_pos>& cands = st.cands[idx + 1];
+                add_candidates(st, idx + 1, cands);
+                //  the list gets reused by the deeper levels only, so it stays intact here
+                for (size_t i = 0; i < cands.size(); i++) descend(st, idx + 1, cands[i]);
+            }
+        }
+        unplace(st, shared);
+    }
+
+    void check_stop() {
+        stop_reason r = stop_reason::None;
+        const size_t spent = nodes_spent += CHECK_NODES;
+        if (run_controller::interrupted()) r = stop_reason::Signal;
+        else if (controller && !controller->has_time_for(0)) r = stop_reason::Deadline;
+        else if (node_budget > 0 && spent >= node_budget) r = stop_reason::MaxNodes;
+        if (r == stop_reason::None) return;
+        int none = (int)stop_reason::None;
+        reason.compare_exchange_strong(none, (int)r);
+    }
+
+    //  max area enclosed by the shapes with the given total perimeter (plus one, as the flood fill
+    //  counts its starting cell even when it's taken)
+    static int area_bound(int perimeter) {
+        const int side8 = perimeter - 8;
+        if (side8 <= 0) return 0;
+        return side8*side8/64 + 1;
+    }
+
+    void evaluate(worker_state& st) {
+        const auto& ring = st.ring;
+
+        //  the placement rules guarantee it, but better safe than sorry
+        for (int i = 0; i < n; i++) {
+            const shape_pos& p1 = ring[i];
+            const shape_pos& p2 = ring[(i + 1)%n];
+            if (overlap_status(get_shape(p1), p1.p(), get_shape(p2), p2.p()) != overlap::Border) return;
+            for (int j = i + 2; j < n; j++) {
+                if (overlap_status(get_shape(p1), p1.p(), get_shape(ring[j]), ring[j].p()) == overlap::Overlap) return;
+            }
+        }
+
+        const int area = shape::flood_fill(variations, ring, [](int, int){}, st.board);
+        if (area <= best_area.load(std::memory_order_relaxed)) return;
+
+        std::lock_guard<std::mutex> lock(best_lock);
+        if (area <= best_area.load(std::memory_order_relaxed)) return;
+        best = ring;
+        best_area.store(area, std::memory_order_relaxed);
+    }
+};
+
+#endif // __BRANCH_BOUND__
@@ -0,0 +1,212 @@
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#include <io.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+#include <layout_hash.hpp>
+#include <checkpoint.h>
+
+static const uint32_t CHECKPOINT_MAGIC = 0x4B434650;    //  "PFCK"
+static const uint32_t CHECKPOINT_VERSION = 3;
+
+static_assert(sizeof(shape_pos) == 8, "shape_pos is stored as is");
+static_assert(sizeof(op_scheduler::state)%8 == 0, "op_scheduler::state keeps the scores aligned");
+
+struct checkpoint::header {
+    uint32_t magic;
+    uint32_t version;
+    uint32_t num_shapes;
+    uint32_t num_layouts;
+    int32_t iteration;
+    uint32_t reserved;
+    uint64_t seed;
+    uint64_t shapes_hash;   //  tells apart the checkpoints of the different shape sets
+    uint64_t checksum;      //  of everything after the header
+};
+
+static uint64_t hash_bytes(uint64_t h, const void* bytes, size_t n) {
+    const uint8_t* p = (const uint8_t*)bytes;
+    for (; n >= 8; n -= 8, p += 8) {
+        uint64_t w;
+        memcpy(&w, p, 8);
+        h = mix64(h ^ w);
+    }
+    uint64_t w = 0;
+    memcpy(&w, p, n);
+    return mix64(h ^ w ^ ((uint64_t)n << 56));
+}
+
+static uint64_t hash_shapes(const shape::variation_array& variations) {
+    uint64_t h = mix64(variations.size());
+    for (const auto& vars : variations) {
+        const auto& squares = vars[0].squares;
+        h = hash_bytes(h, squares.data(), squares.size()*sizeof(vec2i));
+    }
+    return h;
+}
+
+bool replace_file(const std::string& from, const std::string& to) {
+#if defined(_WIN32)
+    return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+#else
+    return std::rename(from.c_str(), to.c_str()) == 0;
+#endif
+}
+
+checkpoint::checkpoint() : data(nullptr), size(0), file_handle(nullptr), map_handle(nullptr) {}
+
+checkpoint::~checkpoint() {
+    close();
+}
+
+bool checkpoint::save(const std::string& path, const shape::variation_array& variations, int iteration, uint64_t seed,
+    const op_scheduler::state& ops, const std::vector<const_layout_ref>& layouts, const std::vector<double>& scores)
+{
+    const size_t nshapes = variations.size();
+    header hdr = {};
+    hdr.magic = CHECKPOINT_MAGIC;
+    hdr.version = CHECKPOINT_VERSION;
+    hdr.num_shapes = (uint32_t)nshapes;
+    hdr.num_layouts = (uint32_t)layouts.size();
+    hdr.iteration = iteration;
+    hdr.seed = seed;
+    hdr.shapes_hash = hash_shapes(variations);
+
+    uint64_t h = hash_bytes(0, &ops, sizeof(ops));
+    h = hash_bytes(h, scores.data(), layouts.size()*sizeof(double));
+    for (const auto& pos : layouts) h = hash_bytes(h, pos.data(), nshapes*sizeof(shape_pos));
+    hdr.checksum = h;
+
+    const std::string tmp_path = path + ".tmp";
+    FILE* f = fopen(tmp_path.c_str(), "wb");
+    if (!f) return false;
+    bool ok = fwrite(&hdr, sizeof(hdr), 1, f) == 1;
+    ok = ok && fwrite(&ops, sizeof(ops), 1, f) == 1;
+    ok = ok && fwrite(scores.data(), sizeof(double), layouts.size(), f) == layouts.size();
+    for (const auto& pos : layouts) {
+        ok = ok && fwrite(pos.data(), sizeof(shape_pos), nshapes, f) == nshapes;
+    }
+    ok = ok && fflush(f) == 0;
+#if defined(_WIN32)
+    ok = ok && _commit(_fileno(f)) == 0;
+#else
+    ok = ok && fsync(fileno(f)) == 0;
+#endif
+    ok = (fclose(f) == 0) && ok;
+    if (!ok) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return replace_file(tmp_path, path);
+}
+
+bool checkpoint::load(const std::string& path, const shape::variation_array& variations) {
+    close();
+
+#if defined(_WIN32)
+    HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+        FILE_ATTRIBUTE_NORMAL, nullptr);
+    if (file == INVALID_HANDLE_VALUE) return false;
+    file_handle = file;
+    LARGE_INTEGER file_size;
+    if (!GetFileSizeEx(file, &file_size) || file_size.QuadPart < (LONGLONG)sizeof(header)) {
+        close();
+        return false;
+    }
+    HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    if (!mapping) {
+        close();
+        return false;
+    }
+    map_handle = mapping;
+    data = (const uint8_t*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+    size = (size_t)file_size.QuadPart;
+#else
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0) return false;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || st.st_size < (off_t)sizeof(header)) {
+        ::close(fd);
+        return false;
+    }
+    void* p = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    data = (p == MAP_FAILED) ? nullptr : (const uint8_t*)p;
+    size = (size_t)st.st_size;
+#endif
+    if (!data) {
+        close();
+        return false;
+    }
+
+    const header& hdr = get_header();
+    const size_t nshapes = variations.size();
+    bool ok = hdr.magic == CHECKPOINT_MAGIC && hdr.version == CHECKPOINT_VERSION &&
+        hdr.num_shapes == nshapes && hdr.shapes_hash == hash_shapes(variations) &&
+        size == scores_offset() + (size_t)hdr.num_layouts*(sizeof(double) + nshapes*sizeof(shape_pos));
+    if (ok) {
+        const uint8_t* layouts = data + scores_offset() + hdr.num_layouts*sizeof(double);
+        uint64_t h = hash_bytes(0, data + sizeof(header), sizeof(op_scheduler::state));
+        h = hash_bytes(h, data + scores_offset(), hdr.num_layouts*sizeof(double));
+        for (uint32_t i = 0; i < hdr.num_layouts; i++) {
+            h = hash_bytes(h, layouts + i*nshapes*sizeof(shape_pos), nshapes*sizeof(shape_pos));
+        }
+        ok = (h == hdr.checksum);
+    }
+    if (!ok) close();
+    return ok;
+}
+
+void checkpoint::close() {
+#if defined(_WIN32)
+    if (data) UnmapViewOfFile(data);
+    if (map_handle) CloseHandle((HANDLE)map_handle);
+    if (file_handle) CloseHandle((HANDLE)file_handle);
+#else
+    if (data) munmap((void*)data, size);
+#endif
+    data = nullptr;
+    size = 0;
+    file_handle = map_handle = nullptr;
+}
+
+const checkpoint::header& checkpoint::get_header() const {
+    return *(const header*)data;
+}
+
+size_t checkpoint::scores_offset() {
+    return sizeof(header) + sizeof(op_scheduler::state);
+}
+
+int checkpoint::get_iteration() const { return get_header().iteration; }
+uint64_t checkpoint::get_seed() const { return get_header().seed; }
+
+op_scheduler::state checkpoint::get_ops() const {
+    op_scheduler::state ops;
+    memcpy(&ops, data + sizeof(header), sizeof(ops));
+    return ops;
+}
+int checkpoint::num_layouts() const { return (int)get_header().num_layouts; }
+
+double checkpoint::get_score(int i) const {
+    double score;
+    memcpy(&score, data + scores_offset() + i*sizeof(double), sizeof(double));
+    return score;
+}
+
+void checkpoint::get_layout(int i, layout_ref res) const {
+    const size_t nshapes = get_header().num_shapes;
+    const uint8_t* src = data + scores_offset() + num_layouts()*sizeof(double) + i*nshapes*sizeof(shape_pos);
+    assert(res.size() >= nshapes);
+    memcpy(res.data(), src, nshapes*sizeof(shape_pos));
+}
@@ -0,0 +1,61 @@
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include <shape.hpp>
+#include <op_scheduler.hpp>
+
+//  binary snapshot of a GA run: the current generation's layouts with their scores (from the best one),
+//  the mutation operators' state (their probabilities depend on the iterations done so far),
+//  and the iteration to continue from, together with the seed (the random streams are keyed by those two,
+//  so nothing else is needed to resume the run exactly). The file is:
+//      header, op_scheduler::state ops, double scores[num_layouts], shape_pos layouts[num_layouts][num_shapes]
+//  and gets loaded by mapping it into memory.
+class checkpoint {
+public:
+    checkpoint();
+    ~checkpoint();
+
+    checkpoint(const checkpoint&) = delete;
+    checkpoint& operator =(const checkpoint&) = delete;
+
+    //  writes to a temporary file first, and then renames it over the given one,
+    //  so there is always either the old or the new checkpoint there, never a half-written one
+    static bool save(const std::string& path, const shape::variation_array& variations, int iteration, uint64_t seed,
+        const op_scheduler::state& ops, const std::vector<const_layout_ref>& layouts, const std::vector<double>& scores);
+
+    //  returns false if the file is missing, damaged, or was saved for another set of shapes
+    bool load(const std::string& path, const shape::variation_array& variations);
+
+    void close();
+
+    int get_iteration() const;
+    uint64_t get_seed() const;
+    op_scheduler::state get_ops() const;
+    int num_layouts() const;
+
+    double get_score(int i) const;
+    //  res has to have the room for all the shapes
+    void get_layout(int i, layout_ref res) const;
+
+private:
+    struct header;
+
+    const uint8_t* data;
+    size_t size;
+
+    //  the platform's handles of the mapping
+    void* file_handle;
+    void* map_handle;
+
+    const header& get_header() const;
+    static size_t scores_offset();
+};
+
+//  renames the file over the other one, replacing it in a single step where the platform allows
+bool replace_file(const std::string& from, const std::string& to);
+
+#endif
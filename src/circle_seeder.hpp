@@ -0,0 +1,210 @@
+#ifndef __CIRCLE_SEEDER__
+#define __CIRCLE_SEEDER__
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+#include <cmath>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+#include <shape_library.hpp>
+
+//  arranges the shapes around the circle, giving exactly the same layouts as shape::arrange_circle
+//  (which tries every variant at every boundary cell of the previous shape, with every own square on it),
+//  with everything that doesn't depend on the particular layout precomputed:
+//  - for every pair of variants, the distinct offsets at which the second one touches the first
+//    without overlapping it, in the order arrange_circle would try them (so the ties resolve the same);
+//  - the angle (atan2) and the squared distance to the circle (sqrt) for the grid cells around it.
+//  It's immutable once built, so it can be shared between the threads.
+class circle_seeder {
+public:
+    //  dist_fn(pos1, pos2) is expected to give the same result as distance() for the placed shapes
+    template <typename TDistFn>
+    circle_seeder(const shape_library& _lib, double _radius, const TDistFn& dist_fn) :
+        lib(_lib), radius(_radius), max_ext(_lib.max_extent()), num_vars(_lib.num_vars())
+    {
+        build_offsets(dist_fn);
+        build_cells();
+    }
+
+    circle_seeder(const circle_seeder&) = delete;
+    circle_seeder& operator =(const circle_seeder&) = delete;
+
+    double get_radius() const { return radius; }
+
+    template <typename TDistFn>
+    void arrange(layout_ref positions, const TDistFn& dist_fn) const {
+        const int nshapes = lib.num_shapes();
+        assert((int)positions.size() == nshapes);
+
+        for (int i = 0; i <= nshapes; i++) {
+            if (i == 0) {
+                shape_pos& pos = positions[i];
+                const shape_library::variant& sh = lib.get(lib.get_var_offset(pos.shape_idx));
+                pos.x = (int16_t)round(radius - sh.width*0.5);
+                pos.y = (int16_t)round(-sh.height*0.5);
+                pos.var_idx = 0;
+            } else {
+                //  closing the ring, the shape also has to touch the next one
+                const shape_pos* next = (i == nshapes) ? &positions[(i + 1)%nshapes] : nullptr;
+                if (!fit_touching(positions[i - 1], positions[i%nshapes], next, dist_fn)) {
+                    fit_all(positions, i, dist_fn);
+                }
+            }
+        }
+    }
+
+private:
+    struct offset {
+        int8_t x, y;
+    };
+
+    struct cell {
+        double angle;   //  in [0, 2*PI)
+        double dr2;     //  (distance from the center - radius)^2
+    };
+
+    const shape_library& lib;
+    double radius;
+    int max_ext;
+    int num_vars;
+
+    //  the touching offsets of the variant v2 next to v1 are [pair_start[p], pair_start[p + 1]),
+    //  p = v1*num_vars + v2
+    std::vector<uint32_t> pair_start;
+    std::vector<offset> offsets;
+
+    //  the cells with both coordinates in [-grid_half, grid_half]
+    int grid_half, grid_side;
+    std::vector<cell> cells;
+
+    template <typename TDistFn>
+    void build_offsets(const TDistFn& dist_fn) {
+        //  the offsets lie within [-max_ext, max_ext], the stamps tell apart the ones already seen
+        const int side = 2*max_ext + 1;
+        std::vector<uint32_t> stamps(side*side, 0);
+        uint32_t stamp = 0;
+
+        pair_start.reserve((size_t)num_vars*num_vars + 1);
+        for (int v1 = 0; v1 < num_vars; v1++) {
+            const shape_library::variant& sh1 = lib.get(v1);
+            const shape_pos pos1 = shape_pos::at({0, 0}, sh1.shape_idx, v1 - lib.get_var_offset(sh1.shape_idx));
+            for (int v2 = 0; v2 < num_vars; v2++) {
+                const shape_library::variant& sh2 = lib.get(v2);
+                const int s2 = sh2.shape_idx;
+                pair_start.push_back((uint32_t)offsets.size());
+                stamp++;
+                for (const auto& bpos : lib.boundary(sh1)) {
+                    for (const auto& sq : lib.squares(sh2)) {
+                        const vec2i offs = bpos.p() - sq.p();
+                        uint32_t& seen = stamps[(offs.x + max_ext) + (offs.y + max_ext)*side];
+                        if (seen == stamp) continue;
+                        seen = stamp;
+                        const shape_pos pos2 = shape_pos::at(offs, s2, v2 - lib.get_var_offset(s2));
+                        if (dist_fn(pos2, pos1) == 0) offsets.push_back({(int8_t)offs.x, (int8_t)offs.y});
+                    }
+                }
+            }
+        }
+        pair_start.push_back((uint32_t)offsets.size());
+    }
+
+    //  the shapes stay within a few extents from the circle
+    void build_cells() {
+        grid_half = (int)std::ceil(radius) + 4*max_ext;
+        grid_side = 2*grid_half + 1;
+        cells.resize(grid_side*grid_side);
+        for (int y = -grid_half; y <= grid_half; y++) {
+            for (int x = -grid_half; x <= grid_half; x++) {
+                cells[(x + grid_half) + (y + grid_half)*grid_side] = compute_cell(vec2i(x, y));
+            }
+        }
+    }
+
+    //  same as in shape::angle_range and shape::dist2circle
+    cell compute_cell(const vec2i& pos) const {
+        double angle = std::atan2(pos.y, pos.x);
+        if (angle < 0) angle += 2*PI;
+        const double dr = pos.len() - radius;
+        return cell{angle, dr*dr};
+    }
+
+    cell get_cell(const vec2i& pos) const {
+        if (abs(pos.x) > grid_half || abs(pos.y) > grid_half) return compute_cell(pos);
+        return cells[(pos.x + grid_half) + (pos.y + grid_half)*grid_side];
+    }
+
+    //  same as sh.angle_range(p).second
+    double max_angle(const shape_library::variant& sh, const vec2i& p) const {
+        double angle = -std::numeric_limits<double>::max();
+        for (const auto& sq : lib.squares(sh)) angle = std::max(angle, get_cell(p + sq.p()).angle);
+        return angle;
+    }
+
+    //  the arrange_circle's score of the shape placed at p, MAX_DIST if it goes back past the previous one
+    double fit_score(const shape_library::variant& sh, const vec2i& p, double prev_angle) const {
+        double angle = -std::numeric_limits<double>::max();
+        double dist = 0.0;
+        for (const auto& sq : lib.squares(sh)) {
+            const cell c = get_cell(p + sq.p());
+            angle = std::max(angle, c.angle);
+            dist += c.dr2;
+        }
+        return angle_greater(angle, prev_angle) ? MAX_DIST : dist/angle;
+    }
+
+    //  places the shape at res next to prev_pos (and touching next, if given), only trying the touching candidates.
+    //  Those are the only ones that can score below MAX_DIST, so if one of them does, it's the one all
+    //  the candidates would give. Returns false otherwise (the first candidate gets picked then), leaving res as it was.
+    template <typename TDistFn>
+    bool fit_touching(const shape_pos& prev_pos, shape_pos& res, const shape_pos* next, const TDistFn& dist_fn) const {
+        const double prev_angle = max_angle(lib.get(prev_pos), prev_pos.p());
+        const int v1 = lib.var_id(prev_pos);
+        const int var_offset = lib.get_var_offset(res.shape_idx);
+        const int nvar = lib.num_variants(res.shape_idx);
+
+        double min_d = MAX_DIST;
+        int best_var = -1;
+        vec2i best_p;
+        for (int var = 0; var < nvar; var++) {
+            const int pair = v1*num_vars + var_offset + var;
+            for (uint32_t k = pair_start[pair]; k < pair_start[pair + 1]; k++) {
+                const vec2i p = prev_pos.p() + vec2i(offsets[k].x, offsets[k].y);
+                if (next && dist_fn(shape_pos::at(p, res.shape_idx, var), *next) != 0) continue;
+                const double d = fit_score(lib.get(var_offset + var), p, prev_angle);
+                if (d < min_d) {
+                    best_var = var;
+                    best_p = p;
+                    min_d = d;
+                }
+            }
+        }
+        if (best_var < 0) return false;
+        res = shape_pos::at(best_p, res.shape_idx, best_var);
+        return true;
+    }
+
+    //  same as a step of shape::arrange_circle
+    template <typename TDistFn>
+    void fit_all(layout_ref positions, int i, const TDistFn& dist_fn) const {
+        const shape::variation_array& variations = lib.get_variations();
+        const int nshapes = lib.num_shapes();
+        const shape_pos& prev_pos = positions[i - 1];
+        const shape& prev_shape = variations[prev_pos.shape_idx][prev_pos.var_idx];
+        const double prev_angle = max_angle(lib.get(prev_pos), prev_pos.p());
+
+        prev_shape.best_fit(positions[i%nshapes], prev_pos.p(), variations[positions[i%nshapes].shape_idx],
+            [&](const shape_pos& cand, const shape&) {
+            if (i == nshapes) {
+                int d1 = dist_fn(cand, positions[(i + 1)%nshapes]);
+                if (d1 != 0) return MAX_DIST + abs(d1);
+            }
+            if (dist_fn(cand, prev_pos) != 0) return MAX_DIST;
+            return fit_score(lib.get(cand), cand.p(), prev_angle);
+        });
+    }
+};
+
+#endif // __CIRCLE_SEEDER__
@@ -0,0 +1,82 @@
+#ifndef __EVAL_CONTEXT__
+#define __EVAL_CONTEXT__
+
+#include <vector>
+#include <algorithm>
+
+#include <shape.hpp>
+#include <shape_library.hpp>
+#include <bitboard.hpp>
+#include <pair_table.hpp>
+#include <layout_eval.hpp>
+#include <batch_score.hpp>
+#include <mutation.hpp>
+#include <op_scheduler.hpp>
+
+//  per-thread scratch state for scoring and mutating the layouts,
+//  everything is sized upfront from the shape set, so the steady-state
+//  generation loop does not touch the heap
+struct eval_context {
+    bitboard board;
+    layout_eval eval;
+
+    //  the working layout, mutated in place and restored through the log
+    std::vector<shape_pos> target;
+    mutation_log log;
+    std::vector<mutation> best_ops;
+
+    //  for scoring the candidates in blocks, block_ops[k] are the mutations of the k-th retry,
+    //  and retry_slots[k] is its slot in the block (-1 if its score came from the cache)
+    batch_scorer batch;
+    layout_block block;
+    std::vector<double> block_scores;
+    std::vector<std::vector<mutation>> block_ops;
+    std::vector<int> retry_slots;
+    std::vector<double> retry_scores;
+    std::vector<uint64_t> retry_keys;
+
+    //  the score cache statistics
+    size_t cache_lookups;
+    size_t cache_hits;
+
+    //  the outcomes of the mutation operators, since the last op_scheduler::update
+    op_stats ops_stats;
+
+    area_method method;
+
+    eval_context(const shape_library& lib, const pair_table* table, int max_flips, 
+        int block_size = 1, area_method _method = area_method::FloodFill) : 
+        eval(lib, table, _method), batch(lib, table, _method), 
+        cache_lookups(0), cache_hits(0), method(_method)
+    {
+        //  the bounds of a layout can't get bigger than all the shapes put in a row
+        const int nshapes = lib.num_shapes();
+        int max_len = 0;
+        for (int s = 0; s < nshapes; s++) {
+            int len = 0;
+            for (int v = 0; v < lib.num_variants(s); v++) {
+                const shape_library::variant& var = lib.get(lib.get_var_offset(s) + v);
+                len = std::max(len, (int)std::max(var.width, var.height));
+            }
+            max_len += len;
+        }
+        const int side = 2*max_len + 1;
+
+        board.reserve(side, side);
+        eval.reserve(nshapes, side, side);
+        target.reserve(nshapes);
+        log.reserve(max_flips, max_flips*nshapes);
+        best_ops.reserve(max_flips);
+
+        batch.reserve(nshapes, block_size, side);
+        block.resize(nshapes, block_size);
+        block_scores.resize(block_size);
+        block_ops.resize(block_size);
+        for (auto& ops : block_ops) ops.reserve(max_flips);
+        retry_slots.resize(block_size);
+        retry_scores.resize(block_size);
+        retry_keys.resize(block_size);
+    }
+};
+
+#endif // __EVAL_CONTEXT__
@@ -0,0 +1,43 @@
+#ifndef __FIXED_SHAPE__
+#define __FIXED_SHAPE__
+
+#include <cstdlib>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <type_traits>
+
+#include <vec2.hpp>
+
+//  the same-order shape sets (see shape::order) get the compile-time trip counts here:
+//  shape_library, batch_scorer and layout_eval dispatch their rasterizing loops on the order,
+//  and pair_table uses fixed_distance for the distances outside of its window.
+
+//  manhattan distance between two sets of N squares, offset by d, minus one
+//  (so -1 if they overlap and 0 if they border), the same as distance()
+template <int N>
+inline int fixed_distance(const vec2i* sq1, const vec2i& d, const vec2i* sq2) {
+    int min_dist = std::numeric_limits<int>::max();
+    for (int i = 0; i < N; i++) {
+        const int x = sq1[i].x + d.x;
+        const int y = sq1[i].y + d.y;
+        for (int j = 0; j < N; j++) {
+            min_dist = std::min(min_dist, abs(x - sq2[j].x) + abs(y - sq2[j].y));
+        }
+    }
+    return min_dist - 1;
+}
+
+//  calls fn(std::integral_constant<int, N>()) with the compile-time order for the
+//  tetrominoes, pentominoes and hexominoes, or with N = 0 otherwise (the generic shape path)
+template <typename TFn>
+inline auto dispatch_order(int order, TFn&& fn) -> decltype(fn(std::integral_constant<int, 0>())) {
+    switch (order) {
+    case 4: return fn(std::integral_constant<int, 4>());
+    case 5: return fn(std::integral_constant<int, 5>());
+    case 6: return fn(std::integral_constant<int, 6>());
+    default: return fn(std::integral_constant<int, 0>());
+    }
+}
+
+#endif // __FIXED_SHAPE__
@@ -0,0 +1,88 @@
+#ifndef __GA_SOLVER__
+#define __GA_SOLVER__
+
+#include <vector>
+
+#include <shape.hpp>
+#include <pair_table.hpp>
+#include <eval_context.hpp>
+#include <task_pool.hpp>
+#include <population.hpp>
+#include <local_search.hpp>
+#include <score_cache.hpp>
+#include <solver.hpp>
+
+//  the genetic algorithm on a single population, with the passes over the children
+//  run on the thread pool, using contexts[worker] for the scratch state
+class ga_solver : public solver {
+public:
+    ga_solver(const shape_library& lib, const pair_table& table, double radius,
+        const ga_config& cfg, task_pool& _pool, std::vector<eval_context>& _contexts, score_cache* cache = nullptr) :
+        pool(_pool), contexts(_contexts), pop(lib, table, radius, cfg, 0, cache) {}
+
+    const char* name() const override { return "ga"; }
+
+    void init() override {
+        pop.init(contexts, [this](int n, auto&& fn) { pool.parallel_for(n, fn); });
+    }
+
+    void step(int it) override {
+        pop.step(it, contexts, [this](int n, auto&& fn) { pool.parallel_for(n, fn); });
+    }
+
+    double best_score() const override { return pop.best_score(); }
+
+    void get_ranked(std::vector<const_layout_ref>& res) const override {
+        res.resize(pop.size());
+        for (int k = 0; k < pop.size(); k++) res[k] = pop.layout(k);
+    }
+
+    size_t num_evals() const override { return pop.num_evals(); }
+
+    const population& get_population() const { return pop; }
+
+    //  continues from the given layouts instead of init(), see population::restore
+    template <typename TGet>
+    void restore(int n, TGet&& get, int it, const op_scheduler::state& ops) {
+        pop.restore(n, get, it, ops, contexts, [this](int count, auto&& fn) { pool.parallel_for(count, fn); });
+    }
+
+protected:
+    task_pool& pool;
+    std::vector<eval_context>& contexts;
+    population pop;
+};
+
+//  the GA with its best layout polished by a local search after every iteration,
+//  and put back into the population (in place of the worst one) if it got any better
+class hybrid_solver : public ga_solver {
+public:
+    hybrid_solver(const shape_library& lib, const pair_table& table, double radius,
+        const ga_config& cfg, task_pool& pool, std::vector<eval_context>& contexts,
+        local_search& _polisher, int _polish_steps, score_cache* cache = nullptr) :
+        ga_solver(lib, table, radius, cfg, pool, contexts, cache),
+        polisher(_polisher), polish_steps(_polish_steps), polished(1) {}
+
+    const char* name() const override { return "hybrid"; }
+
+    void step(int it) override {
+        ga_solver::step(it);
+
+        //  the pool is idle by now, so the polisher can use the first context
+        polisher.start(pop.layout(0));
+        for (int s = 0; s < polish_steps; s++) polisher.step(it*polish_steps + s);
+        if (polisher.best_score() > pop.best_score()) {
+            polished[0] = polisher.get_best();
+            pop.replace_worst(polished, 1, contexts[0]);
+        }
+    }
+
+    size_t num_evals() const override { return pop.num_evals() + polisher.num_evals(); }
+
+private:
+    local_search& polisher;
+    int polish_steps;
+    std::vector<std::vector<shape_pos>> polished;
+};
+
+#endif // __GA_SOLVER__
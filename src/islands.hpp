@@ -0,0 +1,197 @@
+#ifndef __ISLANDS__
+#define __ISLANDS__
+
+#include <vector>
+#include <atomic>
+#include <thread>
+#include <memory>
+#include <chrono>
+#include <limits>
+#include <algorithm>
+
+#include <shape.hpp>
+#include <pair_table.hpp>
+#include <eval_context.hpp>
+#include <population.hpp>
+#include <philox.hpp>
+#include <run_control.hpp>
+
+//  a single-producer single-consumer slot for passing a batch of layouts between two threads:
+//  the sender only writes while the slot is empty and the receiver only reads while it's full,
+//  with the flag handing it over, so neither of them ever blocks
+class mailbox {
+public:
+    mailbox() : full(false), count(0) {}
+
+    //  returns false (dropping the batch) if the previous one has not been taken yet
+    bool post(const std::vector<std::vector<shape_pos>>& layouts, int n) {
+        if (full.load(std::memory_order_acquire)) return false;
+        if ((int)data.size() < n) data.resize(n);
+        for (int i = 0; i < n; i++) data[i] = layouts[i];
+        count = n;
+        full.store(true, std::memory_order_release);
+        return true;
+    }
+
+    //  returns the number of the received layouts, 0 if there was nothing
+    int take(std::vector<std::vector<shape_pos>>& layouts) {
+        if (!full.load(std::memory_order_acquire)) return 0;
+        const int n = count;
+        if ((int)layouts.size() < n) layouts.resize(n);
+        for (int i = 0; i < n; i++) layouts[i] = data[i];
+        full.store(false, std::memory_order_release);
+        return n;
+    }
+
+private:
+    std::atomic<bool> full;
+    int count;
+    std::vector<std::vector<shape_pos>> data;
+};
+
+//  the "retry" part of the random stream key used for picking the migration target
+static const uint32_t RNG_MIGRATION_STREAM = 0xFFFFFFFE;
+
+enum class migration_topology {
+    Ring    = 0,    //  each island sends to the next one
+    Random  = 1,    //  each island sends to a random other one
+};
+
+struct island_config {
+    int num_islands;
+    int migration_interval;     //  iterations between the migrations
+    int num_migrants;           //  the best layouts sent each time
+    migration_topology topology;
+};
+
+//  island-model GA: the populations evolve independently, each one on its own thread,
+//  and every few iterations send their best layouts to the neighbours' mailboxes.
+//  The islands never wait for each other, so the migrations land whenever the receiver
+//  gets to check its mailboxes, and the runs are not reproducible across the machines.
+class island_model {
+public:
+    //  best score of a single island at some point of time since the start
+    struct sample {
+        int ms;
+        double score;
+    };
+
+    island_model(const shape_library& _lib, const pair_table& _table, double radius,
+        const ga_config& gcfg, const island_config& _icfg, area_method method = area_method::FloodFill,
+        score_cache* cache = nullptr) :
+        icfg(_icfg), seed(gcfg.seed), mailboxes(new mailbox[_icfg.num_islands*_icfg.num_islands])
+    {
+        for (int i = 0; i < icfg.num_islands; i++) {
+            islands.emplace_back(new island(_lib, _table, radius, gcfg, i, method, cache));
+        }
+    }
+
+    int num_islands() const { return icfg.num_islands; }
+    const population& get_population(int i) const { return islands[i]->pop; }
+    const eval_context& get_context(int i) const { return islands[i]->contexts[0]; }
+
+    //  the samples of i-th island, one per iteration
+    const std::vector<sample>& get_curve(int i) const { return islands[i]->curve; }
+
+    //  each island stops early if its next iteration would not fit into the controller's time budget,
+    //  or if its own best score has not improved for the controller's stagnation limit,
+    //  the controller gets the reason of the island that stopped last
+    void run(int num_iter, run_controller* ctl = nullptr) {
+        start_time = std::chrono::high_resolution_clock::now();
+        num_running = icfg.num_islands;
+        last_reason = stop_reason::MaxIter;
+        std::vector<std::thread> threads;
+        for (int i = 0; i < icfg.num_islands; i++) {
+            threads.emplace_back([this, i, num_iter, ctl]() { run_island(i, num_iter, ctl); });
+        }
+        for (auto& t : threads) t.join();
+        if (ctl) ctl->set_reason(last_reason);
+    }
+
+private:
+    struct island {
+        std::vector<eval_context> contexts;
+        population pop;
+        std::vector<std::vector<shape_pos>> migrants;
+        std::vector<sample> curve;
+
+        island(const shape_library& lib, const pair_table& table, double radius,
+            const ga_config& gcfg, int idx, area_method method, score_cache* cache) :
+            pop(lib, table, radius, gcfg, idx*gcfg.generation_size, cache)
+        {
+            contexts.emplace_back(lib, &table, gcfg.max_flips, gcfg.retry_block_size, method);
+        }
+    };
+
+    island_config icfg;
+    uint64_t seed;
+    std::vector<std::unique_ptr<island>> islands;
+
+    //  mailboxes[from*num_islands + to]
+    std::unique_ptr<mailbox[]> mailboxes;
+
+    std::chrono::high_resolution_clock::time_point start_time;
+    std::atomic<int> num_running;
+    stop_reason last_reason;    //  set by the last island to stop
+
+    void run_island(int idx, int num_iter, const run_controller* ctl) {
+        using namespace std::chrono;
+        const int n = icfg.num_islands;
+        island& isl = *islands[idx];
+        auto for_each = [](int count, auto&& fn) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+        };
+
+        isl.curve.reserve(num_iter);
+        isl.pop.init(isl.contexts, for_each);
+        double iter_cost = 0;
+        double best = -std::numeric_limits<double>::max();
+        int since_improved = 0;
+        stop_reason reason = stop_reason::MaxIter;
+        for (int it = 0; it < num_iter; it++) {
+            if (ctl && !ctl->has_time_for(iter_cost)) {
+                reason = run_controller::interrupted() ? stop_reason::Signal : stop_reason::Deadline;
+                break;
+            }
+            if (ctl && ctl->stagnated(since_improved)) {
+                reason = stop_reason::Stagnation;
+                break;
+            }
+            auto iter_start = high_resolution_clock::now();
+            isl.pop.step(it, isl.contexts, for_each);
+
+            if (n > 1 && (it + 1)%icfg.migration_interval == 0) {
+                //  send out the best ones
+                int to = (idx + 1)%n;
+                if (icfg.topology == migration_topology::Random) {
+                    philox_rng rng(seed, it, idx, RNG_MIGRATION_STREAM);
+                    to = (idx + 1 + (int)rng.below(n - 1))%n;
+                }
+                int nbest = isl.pop.get_best(icfg.num_migrants, isl.migrants);
+                mailboxes[idx*n + to].post(isl.migrants, nbest);
+
+                //  take in whatever has arrived
+                for (int from = 0; from < n; from++) {
+                    if (from == idx) continue;
+                    int nrecv = mailboxes[from*n + idx].take(isl.migrants);
+                    if (nrecv > 0) isl.pop.replace_worst(isl.migrants, nrecv, isl.contexts[0]);
+                }
+            }
+
+            auto cur_time = high_resolution_clock::now();
+            iter_cost = duration<double>(cur_time - iter_start).count();
+            auto ms = duration_cast<milliseconds>(cur_time - start_time);
+            const double score = isl.pop.best_score();
+            isl.curve.push_back({(int)ms.count(), score});
+            if (score > best) {
+                best = score;
+                since_improved = 0;
+            } else {
+                since_improved++;
+            }
+        }
+        if (--num_running == 0) last_reason = reason;
+    }
+};
+
+#endif // __ISLANDS__
@@ -0,0 +1,48 @@
+#ifndef __LAYOUT_ARENA__
+#define __LAYOUT_ARENA__
+
+#include <vector>
+#include <cstddef>
+
+#include <shape.hpp>
+
+//  a fixed number of the layouts of the same size, stored back to back in a single block
+//  (row i takes [i*stride, (i + 1)*stride)), with their scores in a parallel array.
+//  The rows only move on resize(), so the pointers into them stay valid otherwise,
+//  including across swap(), which just exchanges the blocks.
+class layout_arena {
+public:
+    layout_arena() : count(0), stride(0) {}
+
+    void resize(int _count, int _stride) {
+        count = _count;
+        stride = _stride;
+        positions.assign((size_t)count*stride, {0, 0, 0, 0});
+        scores.assign(count, 0.0);
+    }
+
+    int size() const { return count; }
+    int get_stride() const { return stride; }
+
+    layout_ref row(int i) { return layout_ref(&positions[(size_t)i*stride], stride); }
+    const_layout_ref row(int i) const { return const_layout_ref(&positions[(size_t)i*stride], stride); }
+
+    double& score(int i) { return scores[i]; }
+    double score(int i) const { return scores[i]; }
+
+    void swap(layout_arena& rhs) {
+        std::swap(count, rhs.count);
+        std::swap(stride, rhs.stride);
+        positions.swap(rhs.positions);
+        scores.swap(rhs.scores);
+    }
+
+    size_t memory_size() const { return positions.size()*sizeof(shape_pos) + scores.size()*sizeof(double); }
+
+private:
+    int count, stride;
+    std::vector<shape_pos> positions;
+    std::vector<double> scores;
+};
+
+#endif // __LAYOUT_ARENA__
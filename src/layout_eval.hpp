@@ -0,0 +1,202 @@
+#ifndef __LAYOUT_EVAL__
+#define __LAYOUT_EVAL__
+
+#include <vector>
+#include <cstdint>
+#include <cstdlib>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+#include <shape_library.hpp>
+#include <bitboard.hpp>
+#include <pair_table.hpp>
+#include <fixed_shape.hpp>
+
+//  incremental scorer for the mutated copies of a single "parent" layout:
+//  keeps the parent rasterized (with some margin around) together with the
+//  gaps between the ring neighbours, and only re-does the work for the changed shapes
+class layout_eval {
+public:
+    //  how far the shapes can move from the parent's bounds before falling back to the full scoring
+    static const int MARGIN = 4;
+
+    layout_eval(const shape_library& _lib, const pair_table* _table = nullptr, 
+        area_method _method = area_method::FloodFill) : 
+        lib(_lib), table(_table), method(_method) {}
+
+    //  preallocates the scratch space for layouts with bounds up to the given size
+    void reserve(int nshapes, int w, int h) {
+        parent.reserve(nshapes);
+        gaps.reserve(nshapes);
+        is_changed.reserve(nshapes);
+        board.reserve(w + 2*MARGIN, h + 2*MARGIN);
+        counts.reserve((w + 2*MARGIN)*(h + 2*MARGIN));
+        scratch.reserve(w, h);
+    }
+
+    void set_parent(const_layout_ref positions) {
+        parent.assign(positions.begin(), positions.end());
+        const int n = (int)parent.size();
+
+        vec2i lt, rb;
+        lib.get_bounds(parent, lt, rb);
+        frame_lt = {lt.x - MARGIN, lt.y - MARGIN};
+        frame_w = rb.x - lt.x + 1 + 2*MARGIN;
+        frame_h = rb.y - lt.y + 1 + 2*MARGIN;
+
+        board.reset(frame_w, frame_h);
+        counts.assign(frame_w*frame_h, 0);
+        for (int i = 0; i < n; i++) add_shape<0>(parent[i]);
+
+        gaps.resize(n);
+        total_gap = 0;
+        for (int i = 0; i < n; i++) {
+            gaps[i] = edge_gap(parent, i);
+            total_gap += gaps[i];
+        }
+        is_changed.assign(n, 0);
+    }
+
+    //  scores the layout that differs from the parent only in the "changed" positions
+    //  (the indices may repeat), the result is the same as shape::score would give
+    double score(const_layout_ref positions, const std::vector<int>& changed) {
+        if (!fits_frame(positions, changed)) {
+            if (table) return lib.score(positions, *table, scratch, method);
+            return lib.score(positions, shape::direct_distance{lib.get_variations()}, scratch, method);
+        }
+
+        const bool raster = (method == area_method::FloodFill);
+        dispatch_order(lib.get_order(), [&](auto order) {
+            move_shapes<decltype(order)::value>(parent, positions, changed, 1, raster);
+        });
+
+        int area = raster ? flood_fill(positions) : lib.contour_area(positions);
+
+        double res = area;
+        if (area <= 0) {
+            //  only the edges adjacent to the changed shapes need re-measuring
+            const int n = (int)parent.size();
+            int dist = total_gap;
+            for (int i = 0; i < n; i++) {
+                if (is_changed[i] || is_changed[(i + 1)%n]) {
+                    dist += edge_gap(positions, i) - gaps[i];
+                }
+            }
+            res = -dist;
+        }
+
+        dispatch_order(lib.get_order(), [&](auto order) {
+            move_shapes<decltype(order)::value>(positions, parent, changed, 0, raster);
+        });
+        return res;
+    }
+
+private:
+    const shape_library& lib;
+    const pair_table* table;
+    area_method method;
+    std::vector<shape_pos> parent;
+
+    vec2i frame_lt;
+    int frame_w, frame_h;
+    bitboard board;
+
+    //  used for the full scoring fallback
+    bitboard scratch;
+
+    //  number of shapes covering each cell of the frame
+    std::vector<uint8_t> counts;
+
+    //  gaps[i] is the distance between i-th shape and the next one around the ring
+    std::vector<int> gaps;
+    int total_gap;
+
+    std::vector<char> is_changed;
+
+    int edge_gap(const_layout_ref positions, int i) const {
+        const int n = (int)positions.size();
+        const shape_pos& pos1 = positions[i];
+        const shape_pos& pos2 = positions[(i + 1)%n];
+        if (table) return abs((*table)(pos1, pos2));
+        return abs(shape::direct_distance{lib.get_variations()}(pos1, pos2));
+    }
+
+    bool fits_frame(const_layout_ref positions, const std::vector<int>& changed) const {
+        //  keep at least one free cell around, so the leaking fill still reaches the frame's border
+        for (int i : changed) {
+            const shape_pos& pos = positions[i];
+            const shape_library::variant& v = lib.get(pos);
+            if (pos.x <= frame_lt.x || pos.y <= frame_lt.y ||
+                pos.x + v.width >= frame_lt.x + frame_w ||
+                pos.y + v.height >= frame_lt.y + frame_h) return false;
+        }
+        return true;
+    }
+
+    //  marks the changed shapes (each one once) and moves them on the board from one layout to the other,
+    //  N is the shapes' order if it's specialized (see dispatch_order), 0 otherwise
+    template <int N>
+    void move_shapes(const_layout_ref from, const_layout_ref to, const std::vector<int>& changed,
+        char mark, bool raster)
+    {
+        for (int i : changed) {
+            if (is_changed[i] == mark) continue;
+            is_changed[i] = mark;
+            if (raster) {
+                remove_shape<N>(from[i]);
+                add_shape<N>(to[i]);
+            }
+        }
+    }
+
+    template <int N>
+    void add_shape(const shape_pos& pos) {
+        const shape_library::variant& v = lib.get(pos);
+        const shape_library::cell* sq = lib.squares(v).begin();
+        for (int j = 0; j < lib.num_squares<N>(v); j++) {
+            int x = pos.x + sq[j].x - frame_lt.x;
+            int y = pos.y + sq[j].y - frame_lt.y;
+            if (counts[x + y*frame_w]++ == 0) board.set(x, y);
+        }
+    }
+
+    template <int N>
+    void remove_shape(const shape_pos& pos) {
+        const shape_library::variant& v = lib.get(pos);
+        const shape_library::cell* sq = lib.squares(v).begin();
+        for (int j = 0; j < lib.num_squares<N>(v); j++) {
+            int x = pos.x + sq[j].x - frame_lt.x;
+            int y = pos.y + sq[j].y - frame_lt.y;
+            if (--counts[x + y*frame_w] == 0) board.clear(x, y);
+        }
+    }
+
+    //  same as shape::flood_fill, but over the (already rasterized) frame:
+    //  the starting point still comes from the layout's own bounds,
+    //  and leaking out of the bounds means leaking to the frame's border
+    int flood_fill(const_layout_ref positions) {
+        vec2i lt, rb;
+        lib.get_bounds(positions, lt, rb);
+        int w = rb.x - lt.x + 1;
+        int h = rb.y - lt.y + 1;
+
+        auto is_set = [&](int x, int y) {
+            if (x < 0 || y < 0 || x >= w || y >= h) return true;
+            return board.is_set(x + lt.x - frame_lt.x, y + lt.y - frame_lt.y);
+        };
+
+        vec2i start{w/2, h/2};
+        if (is_set(start.x, start.y)) {
+            for (const vec2i& offs : COFFS) {
+                vec2i c = start + offs;
+                if (!is_set(c.x, c.y)) {
+                    start = c;
+                    break;
+                }
+            }
+        }
+        return board.fill(start.x + lt.x - frame_lt.x, start.y + lt.y - frame_lt.y);
+    }
+};
+
+#endif // __LAYOUT_EVAL__
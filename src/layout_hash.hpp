@@ -0,0 +1,206 @@
+#ifndef __LAYOUT_HASH__
+#define __LAYOUT_HASH__
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+
+inline uint64_t mix64(uint64_t x) {
+    //  splitmix64 finalizer
+    x ^= x >> 30;
+    x *= 0xBF58476D1CE4E5B9ull;
+    x ^= x >> 27;
+    x *= 0x94D049BB133111EBull;
+    x ^= x >> 31;
+    return x;
+}
+
+//  key of a single position of a layout, see layout_key
+inline uint64_t position_key(int i, const shape_pos& pos) {
+    const uint64_t p = ((uint64_t)(uint32_t)pos.x << 32) | (uint32_t)pos.y;
+    const uint64_t s = ((uint64_t)i << 32) | ((uint64_t)pos.shape_idx << 16) | pos.var_idx;
+    return mix64(mix64(p) ^ s);
+}
+
+//  64-bit key of a layout exactly as it is (unlike layout_hasher, it is not invariant
+//  to anything), as the xor of its positions' keys, so it can be updated incrementally
+inline uint64_t layout_key(const_layout_ref positions) {
+    uint64_t key = 0;
+    for (size_t i = 0; i < positions.size(); i++) key ^= position_key((int)i, positions[i]);
+    return key;
+}
+
+//  64-bit hash of the canonical form of a layout, so that the layouts that only differ by
+//  the translation, by where the ring starts and which way it goes (and optionally by one
+//  of the 8 rotations/reflections of the whole thing) get the same hash
+class layout_hasher {
+public:
+    layout_hasher(const shape::variation_array& _variations, bool _dihedral = false) :
+        variations(_variations), dihedral(_dihedral)
+    {
+        int nvars = 0;
+        for (const auto& vars : variations) {
+            var_offset.push_back(nvars);
+            nvars += (int)vars.size();
+        }
+
+        //  where each of the variants goes under each of the transforms
+        transformed.resize(NUM_TRANSFORMS*nvars);
+        for (int t = 0; t < NUM_TRANSFORMS; t++) {
+            for (size_t s = 0; s < variations.size(); s++) {
+                const auto& vars = variations[s];
+                for (size_t v = 0; v < vars.size(); v++) {
+                    transformed[t*nvars + var_offset[s] + v] = transform_variant(vars, (int)v, t);
+                }
+            }
+        }
+        num_vars = nvars;
+    }
+
+    bool is_dihedral() const { return dihedral; }
+
+    uint64_t operator ()(const_layout_ref positions) const {
+        uint64_t res = hash(positions, 0);
+        if (dihedral) {
+            for (int t = 1; t < NUM_TRANSFORMS; t++) res = std::min(res, hash(positions, t));
+        }
+        return res;
+    }
+
+private:
+    //  the rotations by 0, 90, 180 and 270 degrees, then the same after mirroring the x axis
+    static const int NUM_TRANSFORMS = 8;
+
+    struct var_transform {
+        uint16_t var_idx;   //  the transformed variant
+        vec2i offs;         //  the transformed variant's origin, relative to the transformed position
+    };
+
+    const shape::variation_array& variations;
+    bool dihedral;
+    int num_vars;
+    std::vector<int> var_offset;
+    std::vector<var_transform> transformed;
+
+    static vec2i apply(int t, const vec2i& p) {
+        vec2i m = (t >= 4) ? vec2i(-p.x, p.y) : p;
+        switch (t%4) {
+        case 1:  return vec2i(-m.y, m.x);
+        case 2:  return vec2i(-m.x, -m.y);
+        case 3:  return vec2i(m.y, -m.x);
+        default: return m;
+        }
+    }
+
+    static var_transform transform_variant(const std::vector<shape>& vars, int v, int t) {
+        std::vector<vec2i> squares;
+        vec2i lt(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        for (const auto& sq : vars[v].squares) {
+            vec2i p = apply(t, sq);
+            squares.push_back(p);
+            lt.x = std::min(lt.x, (int)p.x);
+            lt.y = std::min(lt.y, (int)p.y);
+        }
+        for (auto& p : squares) p = p - lt;
+
+        auto less = [](const vec2i& a, const vec2i& b) { return a.y == b.y ? a.x < b.x : a.y < b.y; };
+        std::sort(squares.begin(), squares.end(), less);
+        for (size_t i = 0; i < vars.size(); i++) {
+            std::vector<vec2i> other = vars[i].squares;
+            std::sort(other.begin(), other.end(), less);
+            if (other == squares) return {(uint16_t)i, lt};
+        }
+        //  the variants are closed under the transforms, so it's not supposed to get here
+        return {(uint16_t)v, lt};
+    }
+
+    uint64_t hash(const_layout_ref positions, int t) const {
+        const int n = (int)positions.size();
+        if (n == 0) return 0;
+        const var_transform* tr = &transformed[t*num_vars];
+
+        auto get = [&](int i) {
+            const shape_pos& pos = positions[i];
+            const var_transform& vt = tr[var_offset[pos.shape_idx] + pos.var_idx];
+            return shape_pos::at(apply(t, pos.p()) + vt.offs, pos.shape_idx, vt.var_idx);
+        };
+
+        //  the origin goes to the top-left position, the ring starts from the smallest shape index
+        //  and goes towards the smaller one of its neighbours
+        vec2i lt(std::numeric_limits<int>::max(), std::numeric_limits<int>::max());
+        int start = 0;
+        for (int i = 0; i < n; i++) {
+            shape_pos p = get(i);
+            lt.x = std::min(lt.x, (int)p.x);
+            lt.y = std::min(lt.y, (int)p.y);
+            if (positions[i].shape_idx < positions[start].shape_idx) start = i;
+        }
+        const int next = positions[(start + 1)%n].shape_idx;
+        const int prev = positions[(start + n - 1)%n].shape_idx;
+        const int dir = (prev < next) ? n - 1 : 1;
+
+        uint64_t h = mix64((uint64_t)n);
+        for (int k = 0, i = start; k < n; k++, i = (i + dir)%n) {
+            shape_pos p = get(i);
+            const uint64_t v = ((uint64_t)(uint16_t)(p.x - lt.x) << 48) | ((uint64_t)(uint16_t)(p.y - lt.y) << 32) |
+                ((uint64_t)p.shape_idx << 16) | p.var_idx;
+            h = mix64(h ^ v);
+        }
+        return h;
+    }
+};
+
+//  a set of 64-bit hashes with open addressing, cleared without releasing the memory
+class hash_set {
+public:
+    hash_set() : num_items(0) {}
+
+    //  sizes the table for up to n items
+    void reserve(int n) {
+        size_t cap = 16;
+        while (cap < (size_t)n*2) cap *= 2;
+        if (cap > slots.size()) slots.assign(cap, 0);
+    }
+
+    void clear() {
+        if (num_items > 0) std::fill(slots.begin(), slots.end(), 0);
+        num_items = 0;
+    }
+
+    //  returns false if the hash was already there
+    bool insert(uint64_t h) {
+        if (h == 0) h = 1;  //  0 marks the empty slots
+        if ((size_t)(num_items + 1)*2 > slots.size()) grow();
+        const size_t mask = slots.size() - 1;
+        for (size_t i = (size_t)h & mask; ; i = (i + 1) & mask) {
+            if (slots[i] == h) return false;
+            if (slots[i] == 0) {
+                slots[i] = h;
+                num_items++;
+                return true;
+            }
+        }
+    }
+
+    int size() const { return num_items; }
+
+private:
+    std::vector<uint64_t> slots;
+    int num_items;
+
+    void grow() {
+        std::vector<uint64_t> old;
+        old.swap(slots);
+        slots.assign(std::max((size_t)16, old.size()*2), 0);
+        num_items = 0;
+        for (uint64_t h : old) {
+            if (h != 0) insert(h);
+        }
+    }
+};
+
+#endif // __LAYOUT_HASH__
@@ -0,0 +1,198 @@
+#ifndef __LOCAL_SEARCH__
+#define __LOCAL_SEARCH__
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+
+#include <shape.hpp>
+#include <pair_table.hpp>
+#include <eval_context.hpp>
+#include <philox.hpp>
+#include <mutation.hpp>
+#include <layout_hash.hpp>
+#include <circle_seeder.hpp>
+#include <solver.hpp>
+
+//  the "retry" part of the random stream key used for the local search moves,
+//  the "child" part being the move's index within the iteration
+static const uint32_t RNG_LOCAL_SEARCH_STREAM = 0xFFFFFFFD;
+
+//  the local search parameters
+struct local_search_config {
+    int moves_per_step;         //  candidate moves scored per iteration
+    int min_flips, max_flips;   //  mutations per move
+    uint64_t seed;
+
+    //  annealing: the temperature at the start, multiplied by "cooling" after every iteration
+    double start_temp = 2.0;
+    double cooling = 0.99;
+
+    //  tabu: the candidates looked at for each move taken,
+    //  and how many of the recently visited layouts can't be returned to
+    int tabu_candidates = 50;
+    int tabu_tenure = 64;
+};
+
+//  a single trajectory through the layouts, moving by the same mutations as the GA uses,
+//  with the candidate moves scored incrementally against the current layout.
+//  All the scratch state is in the context, so it can be shared with the other users of it
+//  as long as they don't run at the same time.
+class local_search : public solver {
+public:
+    local_search(const shape_library& _lib, const pair_table& _table, double _radius,
+        const local_search_config& _cfg, eval_context& _ctx) :
+        lib(_lib), variations(_lib.get_variations()), table(_table), seeder(_lib, _radius, _table), cfg(_cfg), ctx(_ctx),
+        cur_score(0), best_score_(-std::numeric_limits<double>::max()), num_steps(0), evals(0) {}
+
+    //  starts from the shapes in their original order, arranged around the circle
+    void init() override {
+        const int nshapes = (int)variations.size();
+        std::vector<shape_pos> pos(nshapes, {0, 0, 0, 0});
+        for (int i = 0; i < nshapes; i++) pos[i].shape_idx = i;
+        seeder.arrange(pos, table);
+        start(pos);
+    }
+
+    //  restarts the trajectory (and the annealing schedule) from the given layout,
+    //  the best one found is kept though
+    void start(const_layout_ref layout) {
+        cur.assign(layout.begin(), layout.end());
+        cur_score = lib.score(cur, table, ctx.board, ctx.method);
+        evals++;
+        num_steps = 0;
+        update_best();
+        set_current(layout_key(cur));
+    }
+
+    double best_score() const override { return best_score_; }
+    const std::vector<shape_pos>& get_best() const { return best; }
+
+    void get_ranked(std::vector<const_layout_ref>& res) const override {
+        res.assign(1, best);
+    }
+
+    size_t num_evals() const override { return evals; }
+
+protected:
+    const shape_library& lib;
+    const shape::variation_array& variations;
+    const pair_table& table;
+    circle_seeder seeder;
+    local_search_config cfg;
+    eval_context& ctx;
+
+    std::vector<shape_pos> cur;
+    double cur_score;
+    std::vector<shape_pos> best;
+    double best_score_;
+
+    //  iterations since the start
+    int num_steps;
+    size_t evals;
+
+    //  mutates the current layout (the changes go to ctx.log), returns the new score
+    double try_move(philox_rng& rng) {
+        mutate(variations, cfg.min_flips, cfg.max_flips, cur, ctx.log, rng);
+        evals++;
+        return ctx.eval.score(cur, ctx.log.changed);
+    }
+
+    void reject() {
+        ctx.log.undo(cur);
+    }
+
+    void accept(double score) {
+        cur_score = score;
+        update_best();
+        set_current(ctx.log.key);
+    }
+
+private:
+    void update_best() {
+        if (cur_score <= best_score_) return;
+        best_score_ = cur_score;
+        best = cur;
+        lib.center(best);
+    }
+
+    void set_current(uint64_t key) {
+        ctx.eval.set_parent(cur);
+        ctx.log.set_key(key);
+        ctx.log.clear();
+    }
+};
+
+//  simulated annealing: the worse moves get taken with the probability of exp(delta/temperature)
+class annealing_solver : public local_search {
+public:
+    using local_search::local_search;
+
+    const char* name() const override { return "anneal"; }
+
+    void step(int it) override {
+        const double temp = cfg.start_temp*pow(cfg.cooling, num_steps);
+        for (int k = 0; k < cfg.moves_per_step; k++) {
+            philox_rng rng(cfg.seed, it, k, RNG_LOCAL_SEARCH_STREAM);
+            const double score = try_move(rng);
+            const double delta = score - cur_score;
+            if (delta >= 0 || (temp > 0 && (rng() + 0.5)/4294967296.0 < exp(delta/temp))) {
+                accept(score);
+            } else {
+                reject();
+            }
+        }
+        num_steps++;
+    }
+};
+
+//  tabu search: every move goes to the best of a few sampled neighbours, even if it's worse than
+//  the current layout, but never back to one of the recently visited layouts
+//  (unless that would beat the best score so far)
+class tabu_solver : public local_search {
+public:
+    tabu_solver(const shape_library& lib, const pair_table& table, double radius,
+        const local_search_config& cfg, eval_context& ctx) :
+        local_search(lib, table, radius, cfg, ctx), tabu(std::max(1, cfg.tabu_tenure), 0), tabu_pos(0) {}
+
+    const char* name() const override { return "tabu"; }
+
+    void step(int it) override {
+        const int ncand = std::max(1, cfg.tabu_candidates);
+        for (int k0 = 0; k0 < cfg.moves_per_step; k0 += ncand) {
+            double max_score = -std::numeric_limits<double>::max();
+            uint64_t max_key = 0;
+            ctx.best_ops.clear();
+            for (int k = k0; k < std::min(k0 + ncand, cfg.moves_per_step); k++) {
+                philox_rng rng(cfg.seed, it, k, RNG_LOCAL_SEARCH_STREAM);
+                const double score = try_move(rng);
+                if (score > max_score && (score > best_score_ || !is_tabu(ctx.log.key))) {
+                    max_score = score;
+                    max_key = ctx.log.key;
+                    ctx.best_ops = ctx.log.ops;
+                }
+                reject();
+            }
+            if (ctx.best_ops.empty()) continue;
+
+            for (const mutation& m : ctx.best_ops) ctx.log.apply(cur, m);
+            accept(max_score);
+            tabu[tabu_pos] = max_key;
+            tabu_pos = (tabu_pos + 1)%(int)tabu.size();
+        }
+        num_steps++;
+    }
+
+private:
+    //  the keys of the recently visited layouts, as a ring buffer
+    std::vector<uint64_t> tabu;
+    int tabu_pos;
+
+    bool is_tabu(uint64_t key) const {
+        return std::find(tabu.begin(), tabu.end(), key) != tabu.end();
+    }
+};
+
+#endif // __LOCAL_SEARCH__
@@ -5,16 +5,32 @@
 #include <ctime>
 #include <ratio>
 #include <chrono>
+#include <cstdio>
+#include <cstdlib>
 
 #include <shape.hpp>
+#include <shape_library.hpp>
+#include <pair_table.hpp>
+#include <eval_context.hpp>
+#include <task_pool.hpp>
+#include <population.hpp>
+#include <islands.hpp>
+#include <local_search.hpp>
+#include <ga_solver.hpp>
+#include <branch_bound.hpp>
+#include <run_control.hpp>
+#include <score_cache.hpp>
+#include <alloc_stats.h>
 #include <svg_gen.h>
+#include <checkpoint.h>
+#include <result_writer.h>
 
 static const int SVG_CELL_SIDE = 10; 
 static const int GENERATION_SIZE = 10000;
 static const int NUM_ITER = 1000;
 
 static const int NUM_ELITE = 1;
-static const int NUM_MUTATED = (int)(GENERATION_SIZE*0.9);
+static const double MUTATED_SHARE = 0.9;
 static const int SEED = 12345;
 
 static const int NUM_RETRIES = 1000;
@@ -22,12 +38,121 @@ static const int MIN_FLIPS = 2;
 static const int MAX_FLIPS = 4;
 
 static const int ITER_DUMP_AFTER = 1;
+//  the html gets rendered on a thread of its own, and no more often than this
+static const int HTML_MIN_INTERVAL_MS = 1000;
+static const int HTML_MAX_LAYOUTS = 100;
+
+//  the run also stops when it's out of the time budget (in seconds, 0 means no limit,
+//  can be given as the third argument), or when the best score has not improved for this many iterations
+static const double TIME_BUDGET = 0;
+static const int STAGNATION_ITER = 200;
+
+//  max relative offset between two shapes covered by the precomputed distance table
+static const int PAIR_TABLE_WINDOW = 8;
+
+//  how the enclosed area gets measured when scoring
+static const area_method AREA_METHOD = area_method::FloodFill;
+
+//  the retries are scored in blocks of this size through batch_scorer,
+//  1 means scoring them one by one, incrementally from the parent
+static const int RETRY_BLOCK_SIZE = 64;
+
+//  the exact mode gives up after searching this many nodes (or when out of the time budget), reporting
+//  the best ring found so far as not proven, 0 means no limit
+static const size_t EXACT_MAX_NODES = 1000000000;
+
+//  number of the worker threads, 0 means one per hardware thread
+static const int NUM_THREADS = 0;
+
+//  memory for the cache of the already seen layouts' scores, 0 disables it
+static const int SCORE_CACHE_MB = 64;
+
+//  whether the rotated/reflected copies of a layout count as duplicates
+static const bool CANONICAL_DIHEDRAL = true;
+
+//  whether the duplicates within a generation get pushed to the bottom of the ranking
+static const bool UNIQUE_GENERATION = false;
+
+//  whether the mutation types and the number of flips (MIN_FLIPS..MAX_FLIPS) get picked
+//  by how often they've been improving the layouts lately, rather than uniformly
+static const bool ADAPTIVE_OPERATORS = true;
+
+//  how the parents get picked: Rank needs the whole generation sorted every iteration,
+//  Tournament and RankBuckets only sort the best SORTED_HEAD ones (the rest gets partitioned around
+//  the head, or at the RANK_BUCKETS quantiles), which is what matters with the generations of millions
+static const selection_method SELECTION = selection_method::Tournament;
+static const int TOURNAMENT_SIZE = 4;
+static const int RANK_BUCKETS = 16;
+static const int SORTED_HEAD = 100;
+
+//  the island mode ("islands" as the second argument) splits GENERATION_SIZE between
+//  this many populations, each evolving on its own thread
+static const int NUM_ISLANDS = 8;
+static const int MIGRATION_INTERVAL = 10;
+static const int NUM_MIGRANTS = 2;
+static const migration_topology MIGRATION_TOPOLOGY = migration_topology::Ring;
+
+//  the local search modes: "anneal" (simulated annealing), "tabu" and "hybrid" (the GA, with its
+//  best layout polished by the tabu search after every iteration), scoring this many moves per iteration
+static const int LS_MOVES_PER_STEP = 100000;
+static const double ANNEAL_START_TEMP = 2.0;
+static const double ANNEAL_COOLING = 0.99;
+static const int TABU_CANDIDATES = 50;
+static const int TABU_TENURE = 64;
+static const int HYBRID_POLISH_STEPS = 1;
+
+//  the GA state gets saved here every this many iterations (0 means never) and when the run stops,
+//  a run can continue from a checkpoint given as the fourth argument
+static const char* CHECKPOINT_FILE = "out/checkpoint.bin";
+static const int CHECKPOINT_INTERVAL = 10;
+
+//  the best score versus the wall time gets written here, per mode
+static const char* CURVE_FILE = "out/curve_%s.csv";
+
+static void write_curve(const std::string& mode, const std::vector<std::pair<int, double>>& curve) {
+    char path[256];
+    snprintf(path, sizeof(path), CURVE_FILE, mode.c_str());
+    std::ofstream ofs(path);
+    ofs << "ms,score\n";
+    for (const auto& c : curve) ofs << c.first << "," << c.second << "\n";
+}
+
+//  where the evaluations went, per mutation type and per number of flips
+static void print_op_stats(const op_scheduler& sched) {
+    static const char* TYPE_NAMES[op_stats::NUM_TYPES] = {"reroll", "shift", "swap"};
+    auto print_arm = [](const op_stats::arm& a, double prob) {
+        std::cout << "uses: " << a.uses << ", improved: " << 100.0*a.improvements/std::max<uint64_t>(a.uses, 1) <<
+            "%, gain/use: " << (double)a.gain/std::max<uint64_t>(a.uses, 1) << ", probability: " << prob << std::endl;
+    };
+    const op_stats& totals = sched.get_totals();
+    std::cout << "Operators (" << (sched.is_adaptive() ? "adaptive" : "uniform") << "):" << std::endl;
+    for (int i = 0; i < op_stats::NUM_TYPES; i++) {
+        std::cout << "  " << TYPE_NAMES[i] << ": ";
+        print_arm(totals.types[i], sched.type_prob(i));
+    }
+    for (int n = sched.get_min_flips(); n <= sched.get_max_flips(); n++) {
+        std::cout << "  " << n << " flips: ";
+        print_arm(totals.flips[n - sched.get_min_flips()], sched.flips_prob(n));
+    }
+}
+
 
 int main(int argc, char* argv[]) {
 
     std::string shape_file = "data/pentominoes.txt";
+    std::string mode = "ga";
 
     if (argc > 1) shape_file = argv[1];
+    if (argc > 2) mode = argv[2];
+
+    run_limits limits;
+    limits.max_iter = NUM_ITER;
+    limits.time_budget = (argc > 3) ? atof(argv[3]) : TIME_BUDGET;
+    limits.stagnation_iter = STAGNATION_ITER;
+    run_controller::catch_signals();
+
+    std::string resume_file;
+    if (argc > 4) resume_file = argv[4];
 
     std::ifstream ifs(shape_file);
     std::string line;
@@ -36,168 +161,261 @@ int main(int argc, char* argv[]) {
 
     shape::variation_array variations;
     for (const auto& sh: shapes) variations.push_back(sh.get_variations());
+    const shape_library lib(variations);
+    std::cout << "Shape library: " << lib.num_vars() << " variants, size: " << lib.memory_size() << "B" << std::endl;
 
     //  estimate the radius
     double len = 0.0;
     for (const shape& sh : shapes) len += sh.estimate_len();
     double R = len/(2.0*PI);
 
-    const int nshapes = (int)shapes.size();
-    
-    srand(SEED);
-
-    std::vector<std::vector<shape_pos>> gen[2];
-    gen[0].resize(GENERATION_SIZE);
-    gen[1].resize(GENERATION_SIZE);
-
-    struct lscore {
-        std::vector<shape_pos>* pos;
-        double score;
-        bool operator <(const lscore& rhs) const {return score > rhs.score; }
-        bool operator ==(const lscore& rhs) const {return *pos == *rhs.pos; }
-    };
-    std::vector<lscore> scores(GENERATION_SIZE);
+    pair_table table(variations, PAIR_TABLE_WINDOW);
+    std::cout << "Pair table: " << table.get_num_vars() << " variants, window: " << table.get_window() << 
+        ", size: " << table.memory_size()/1024 << "KB, built in: " << table.get_build_ms() << "ms" << 
+        ", fixed order: " << table.get_order() << std::endl;
+
+    ga_config cfg;
+    cfg.generation_size = GENERATION_SIZE;
+    cfg.num_elite = NUM_ELITE;
+    cfg.mutated_share = MUTATED_SHARE;
+    cfg.num_retries = NUM_RETRIES;
+    cfg.min_flips = MIN_FLIPS;
+    cfg.max_flips = MAX_FLIPS;
+    cfg.retry_block_size = RETRY_BLOCK_SIZE;
+    cfg.seed = SEED;
+    cfg.canonical_dihedral = CANONICAL_DIHEDRAL;
+    cfg.unique_generation = UNIQUE_GENERATION;
+    cfg.adaptive_ops = ADAPTIVE_OPERATORS;
+    cfg.selection = SELECTION;
+    cfg.tournament_size = TOURNAMENT_SIZE;
+    cfg.rank_buckets = RANK_BUCKETS;
+    cfg.sorted_head = SORTED_HEAD;
+
+    layout_hasher hasher(variations, CANONICAL_DIHEDRAL);
+    result_writer html(variations, hasher, "out/test.html", HTML_MIN_INTERVAL_MS, HTML_MAX_LAYOUTS, SVG_CELL_SIDE);
+
+    std::unique_ptr<score_cache> cache;
+    if (SCORE_CACHE_MB > 0) {
+        cache.reset(new score_cache((size_t)SCORE_CACHE_MB << 20));
+        std::cout << "Score cache: " << cache->capacity() << " entries, size: " << 
+            cache->memory_size()/(1 << 20) << "MB" << std::endl;
+    }
 
     using namespace std::chrono;
-    high_resolution_clock::time_point start_time = high_resolution_clock::now();
-
-    auto* cur_gen  = &gen[0];
-    auto* prev_gen = &gen[1];
-
-    //  seed the first generation
-    for (int k = 0; k < GENERATION_SIZE; k++) {
-        auto& pos = (*cur_gen)[k];
-        pos.resize(nshapes, {0, 0, 0, 0});
-        for (int i = 0; i < nshapes; i++) pos[i].shape_idx = i;
-
-        //std::random_shuffle(pos.begin(), pos.end());
-        shape::arrange_circle(R, variations, pos);
-        scores[k].score = shape::score(variations, pos);
-        scores[k].pos = &pos;
-    }
-    std::sort(scores.begin(), scores.end());
-
-    for (int it = 0; it < NUM_ITER; it++) {
-        std::swap(cur_gen, prev_gen);
-
-        int ii = 0;
-        //  transfer the "elite" ones (making sure there is no duplicates)
-        for (int i = 0; i < GENERATION_SIZE; i++) {
-            const auto& pos = *(scores[i].pos);
-            bool dupe = false;
-            for (int j = 0; j < ii; j++) {
-                if ((*cur_gen)[j] == pos) {
-                    dupe = true;
-                    break;
-                } 
+    high_resolution_clock::time_point run_start = high_resolution_clock::now();
+    run_controller ctl(limits);
+    std::vector<std::pair<int, double>> curve;
+    std::vector<const_layout_ref> ranked;
+
+    if (mode == "islands") {
+        island_config icfg;
+        icfg.num_islands = NUM_ISLANDS;
+        icfg.migration_interval = MIGRATION_INTERVAL;
+        icfg.num_migrants = NUM_MIGRANTS;
+        icfg.topology = MIGRATION_TOPOLOGY;
+
+        ga_config island_cfg = cfg;
+        island_cfg.generation_size = std::max(GENERATION_SIZE/NUM_ISLANDS, NUM_ELITE + 1);
+
+        std::cout << "Islands: " << NUM_ISLANDS << " x " << island_cfg.generation_size << std::endl;
+        island_model model(lib, table, R, island_cfg, icfg, AREA_METHOD, cache.get());
+        model.run(NUM_ITER, &ctl);
+
+        //  the best over all the islands, at the time each island finished an iteration
+        std::vector<island_model::sample> samples;
+        for (int i = 0; i < NUM_ISLANDS; i++) {
+            const auto& c = model.get_curve(i);
+            samples.insert(samples.end(), c.begin(), c.end());
+        }
+        std::sort(samples.begin(), samples.end(), 
+            [](const island_model::sample& a, const island_model::sample& b) { return a.ms < b.ms; });
+        double best = -std::numeric_limits<double>::max();
+        for (const auto& s : samples) {
+            if (s.score > best) {
+                best = s.score;
+                curve.push_back({s.ms, best});
+                std::cout << "Time: " << s.ms << "ms, max score: " << best << std::endl;
             }
-            if (!dupe) (*cur_gen)[ii++] = pos;
-            if (ii == NUM_ELITE) break;
         }
 
-        //  apply the mutations
-        for (int i = 0; i < NUM_MUTATED; i++) {
-            // pick the source gene
-            int pick_size = GENERATION_SIZE;
-            int idx = (int)sqrtf((float)(rand()%(pick_size*pick_size)));
-            const auto& src = *(scores[idx].pos);
-            auto& dst = (*cur_gen)[ii++];
-
-            std::vector<shape_pos> max_target;
-            double max_score = -std::numeric_limits<double>::max();
-
-            for (int ii = 0; ii < NUM_RETRIES; ii++) {
-                std::vector<shape_pos> target = src;
-
-                int num_flips = rand()%(MAX_FLIPS - MIN_FLIPS + 1) + MIN_FLIPS;
-                for (int iii = 0; iii < num_flips; iii++) {
-                    int mutation = rand()%3;
-                    int pidx1 = rand()%nshapes;
-                    int pidx2 = rand()%nshapes;
-
-                    if (mutation == 0) {
-                        target[pidx1].var_idx = (uint16_t)(rand()%variations[target[pidx1].shape_idx].size());
-                        target[pidx2].var_idx = (uint16_t)(rand()%variations[target[pidx2].shape_idx].size());
-                    } else if (mutation == 1) {
-                        const vec2i& offs = COFFS[rand()%8];
-                        for (int k = pidx1;  k <= pidx2; k++) {
-                            target[k].x += offs.x;
-                            target[k].y += offs.y;
-                        }
-                    } else if (mutation == 2) {
-                        std::swap(target[pidx1].shape_idx, target[pidx2].shape_idx);
-                        std::swap(target[pidx1].var_idx, target[pidx2].var_idx);
-                    }
-                }
-
-                double score = shape::score(variations, target);
-                if (score > max_score) {
-                    max_score = score;
-                    max_target = target;
-                }
+        std::vector<std::pair<double, const_layout_ref>> all;
+        for (int i = 0; i < NUM_ISLANDS; i++) {
+            const population& pop = model.get_population(i);
+            for (int k = 0; k < pop.size(); k++) all.push_back({pop.ranked()[k].score, pop.layout(k)});
+        }
+        std::stable_sort(all.begin(), all.end(), 
+            [](const std::pair<double, const_layout_ref>& a, const std::pair<double, const_layout_ref>& b) { return a.first > b.first; });
+        for (const auto& s : all) ranked.push_back(s.second);
+
+        size_t lookups = 0, hits = 0, evals = 0;
+        for (int i = 0; i < NUM_ISLANDS; i++) {
+            lookups += model.get_context(i).cache_lookups;
+            hits += model.get_context(i).cache_hits;
+            evals += model.get_population(i).num_evals();
+        }
+        if (lookups > 0) std::cout << "Cache hit rate: " << 100.0*hits/lookups << "%" << std::endl;
+        const double secs = duration_cast<duration<double>>(high_resolution_clock::now() - run_start).count();
+        std::cout << "Evals/s: " << (size_t)(evals/std::max(secs, 1e-6)) << std::endl;
+        std::cout << "Stopped (" << to_string(ctl.get_reason()) << "), max score: " << best << 
+            ", time: " << (int)(ctl.elapsed()*1000) << "ms" << std::endl;
+        html.post(ranked);
+    } else if (mode == "exact") {
+        //  only finishes for the small sets, like the tetrominoes, the bigger ones run out of the budgets
+        task_pool pool(NUM_THREADS);
+        std::cout << "Threads: " << pool.size() << std::endl;
+        branch_bound bb(variations);
+        const bool found = bb.run(pool, &ctl, EXACT_MAX_NODES);
+        std::cout << "Nodes: " << bb.get_num_nodes() << ", time: " << bb.get_ms() << "ms, nodes/s: " << 
+            (size_t)(bb.get_num_nodes()*1000.0/std::max(1, bb.get_ms())) << std::endl;
+        if (found) {
+            if (bb.proven()) {
+                std::cout << "Proven optimum: " << bb.best_score() << std::endl;
+            } else {
+                std::cout << "Stopped (" << to_string(bb.get_reason()) << "), best score found: " << 
+                    bb.best_score() << ", not proven" << std::endl;
             }
+            curve.push_back({bb.get_ms(), bb.best_score()});
+            ranked.assign(1, bb.get_best());
+            html.post(ranked);
+        } else if (bb.proven()) {
+            std::cout << "None of the rings encloses any area" << std::endl;
+        } else {
+            std::cout << "Stopped (" << to_string(bb.get_reason()) << ") before any ring was found" << std::endl;
+        }
+    } else {
+        task_pool pool(NUM_THREADS);
+        std::cout << "Threads: " << pool.size() << std::endl;
+
+        //  the scratch state for each of the workers
+        std::vector<eval_context> contexts;
+        contexts.reserve(pool.size());
+        for (int i = 0; i < pool.size(); i++) {
+            contexts.emplace_back(lib, &table, MAX_FLIPS, RETRY_BLOCK_SIZE, AREA_METHOD);
+        }
 
-            dst = max_target;
+        local_search_config lcfg;
+        lcfg.moves_per_step = LS_MOVES_PER_STEP;
+        lcfg.min_flips = MIN_FLIPS;
+        lcfg.max_flips = MAX_FLIPS;
+        lcfg.seed = SEED;
+        lcfg.start_temp = ANNEAL_START_TEMP;
+        lcfg.cooling = ANNEAL_COOLING;
+        lcfg.tabu_candidates = TABU_CANDIDATES;
+        lcfg.tabu_tenure = TABU_TENURE;
+
+        //  the random streams are keyed by the seed and the iteration, so those (together with the operators'
+        //  probabilities) are all it takes to continue
+        checkpoint ck;
+        int start_iter = 0;
+        if (!resume_file.empty()) {
+            if (!ck.load(resume_file, variations)) {
+                std::cout << "Can't load the checkpoint: " << resume_file << std::endl;
+                return 1;
+            }
+            cfg.seed = ck.get_seed();
+            start_iter = ck.get_iteration();
         }
 
-        //  pad the rest with the fresh ones
-        for (; ii < GENERATION_SIZE; ii++) {
-            auto& pos = (*cur_gen)[ii];
-            pos.resize(nshapes, {0, 0, 0, 0});
-            for (int i = 0; i < nshapes; i++) pos[i].shape_idx = i;
-            std::random_shuffle(pos.begin(), pos.end());
-            shape::arrange_circle(R, variations, pos);
+        std::unique_ptr<local_search> polisher;
+        std::unique_ptr<solver> engine;
+        ga_solver* ga = nullptr;
+        if (mode == "ga") {
+            engine.reset(ga = new ga_solver(lib, table, R, cfg, pool, contexts, cache.get()));
+        } else if (mode == "anneal") {
+            engine.reset(new annealing_solver(lib, table, R, lcfg, contexts[0]));
+        } else if (mode == "tabu") {
+            engine.reset(new tabu_solver(lib, table, R, lcfg, contexts[0]));
+        } else if (mode == "hybrid") {
+            polisher.reset(new tabu_solver(lib, table, R, lcfg, contexts[0]));
+            engine.reset(ga = new hybrid_solver(lib, table, R, cfg, pool, contexts, 
+                *polisher, HYBRID_POLISH_STEPS, cache.get()));
+        } else {
+            std::cout << "Unknown mode: " << mode << std::endl;
+            return 1;
         }
 
-        //  score the current generation
-        for (int k = 0; k < GENERATION_SIZE; k++) {
-            auto& pos = (*cur_gen)[k];
-            shape::center(variations, pos);
-            scores[k].score = shape::score(variations, pos);
-            scores[k].pos = &pos;
+        high_resolution_clock::time_point start_time = high_resolution_clock::now();
+        if (!resume_file.empty()) {
+            if (!ga) {
+                std::cout << "Only the GA modes can continue from a checkpoint" << std::endl;
+                return 1;
+            }
+            ga->restore(ck.num_layouts(), [&](int i, layout_ref pos) {
+                ck.get_layout(i, pos);
+                return ck.get_score(i);
+            }, start_iter, ck.get_ops());
+            std::cout << "Resumed from iteration " << start_iter << ", layouts: " << ck.num_layouts() << 
+                ", max score: " << engine->best_score() << ", in: " << 
+                duration_cast<milliseconds>(high_resolution_clock::now() - start_time).count() << "ms" << std::endl;
+            ck.close();
+        } else {
+            engine->init();
         }
-        std::sort(scores.begin(), scores.end());
-
-        high_resolution_clock::time_point cur_time = high_resolution_clock::now();
-        auto int_ms = duration_cast<std::chrono::milliseconds>(cur_time - start_time);
-        std::cout << "Iteration: " << it << ", max score: " << scores[0].score << 
-            ", time: " << int_ms.count() << "ms" << std::endl;
-        start_time = cur_time;
-
-        if ((it%ITER_DUMP_AFTER == 0) || it == NUM_ITER - 1) {
-            std::ofstream ofs("out/test.html");
-            ofs << "<div>\n";    
-
-            int ndisp = std::min(100, GENERATION_SIZE);
-            int k = 0, cur_pos = 0;
-            while (cur_pos < ndisp && k < GENERATION_SIZE) {
-                const auto& pos = *(scores[k].pos);
-
-                //  check if a duplicate
-                bool dupe = false;
-                for (int kk = 0; kk < k; kk++) {
-                    if (pos == *(scores[kk].pos)) dupe = true;
-                }
-
-                k++;
-                if (dupe) continue;
-                cur_pos++;
-
-                shape core;
-                vec2i core_pos;
-                bool has_core = shape::extract_core(variations, pos, core, core_pos);
-                if (has_core) {
-                    create_svg(ofs, variations, pos, &core, &core_pos, SVG_CELL_SIDE);
-                } else {
-                    create_svg(ofs, variations, pos, nullptr, nullptr, SVG_CELL_SIDE);
-                }
+
+        std::vector<double> ranked_scores;
+        auto save_checkpoint = [&](int next_iter) {
+            engine->get_ranked(ranked);
+            ranked_scores.resize(ranked.size());
+            for (size_t k = 0; k < ranked.size(); k++) ranked_scores[k] = ga->get_population().ranked()[k].score;
+            if (!checkpoint::save(CHECKPOINT_FILE, variations, next_iter, cfg.seed, 
+                ga->get_population().get_scheduler().get_state(), ranked, ranked_scores)) {
+                std::cout << "Can't write the checkpoint: " << CHECKPOINT_FILE << std::endl;
             }
+        };
 
-            ofs << "</div>\n";
-            ofs.close();   
+        auto cache_stats = [&](size_t& lookups, size_t& hits) {
+            lookups = hits = 0;
+            for (const auto& ctx : contexts) {
+                lookups += ctx.cache_lookups;
+                hits += ctx.cache_hits;
+            }
+        };
+
+        int it = start_iter;
+        for (; ctl.keep_going(it); it++) {
+            const size_t start_allocs = num_allocs();
+            const size_t start_evals = engine->num_evals();
+            size_t start_lookups, start_hits;
+            cache_stats(start_lookups, start_hits);
+            engine->step(it);
+
+            const size_t iter_allocs = num_allocs() - start_allocs;
+            size_t lookups, hits;
+            cache_stats(lookups, hits);
+            high_resolution_clock::time_point cur_time = high_resolution_clock::now();
+            auto int_ms = duration_cast<std::chrono::milliseconds>(cur_time - start_time);
+            const double secs = duration_cast<duration<double>>(cur_time - start_time).count();
+            std::cout << "Iteration: " << it << ", max score: " << engine->best_score() << 
+                ", time: " << int_ms.count() << "ms, evals/s: " << 
+                (size_t)((engine->num_evals() - start_evals)/std::max(secs, 1e-6)) << 
+                ", allocations: " << iter_allocs;
+            if (lookups > start_lookups) {
+                std::cout << ", cache hits: " << 100.0*(hits - start_hits)/(lookups - start_lookups) << "%";
+            }
+            std::cout << std::endl;
+            start_time = cur_time;
+            curve.push_back({(int)duration_cast<milliseconds>(cur_time - run_start).count(), engine->best_score()});
+            ctl.iteration_done(engine->best_score());
+
+            if (it%ITER_DUMP_AFTER == 0) {
+                engine->get_ranked(ranked);
+                html.post(ranked);
+            }
+            if (ga && CHECKPOINT_INTERVAL > 0 && (it + 1)%CHECKPOINT_INTERVAL == 0) save_checkpoint(it + 1);
         }
+        if (ga) save_checkpoint(it);
+
+        //  whatever made it stop, the latest results get written out
+        engine->get_ranked(ranked);
+        html.post(ranked);
+        std::cout << "Stopped after " << it << " iterations (" << to_string(ctl.get_reason()) << "), " << 
+            "max score: " << engine->best_score() << ", time: " << (int)(ctl.elapsed()*1000) << "ms" << std::endl;
+        if (ga) print_op_stats(ga->get_population().get_scheduler());
     }
-    
+
+    html.flush();
+    std::cout << "Html written: " << html.num_written() << " times, unchanged: " << html.num_unchanged() << std::endl;
+    write_curve(mode, curve);
     return 0;
 }
 
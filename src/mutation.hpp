@@ -0,0 +1,152 @@
+#ifndef __MUTATION__
+#define __MUTATION__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+
+#include <shape.hpp>
+#include <philox.hpp>
+#include <layout_hash.hpp>
+
+enum class mutation_type : uint8_t {
+    Reroll  = 0,    //  picks the new random variants for two shapes
+    Shift   = 1,    //  moves the range of shapes by one of COFFS
+    Swap    = 2,    //  swaps two shapes (together with their variants)
+};
+
+//  a single mutation operator, with all of its random choices already made,
+//  so it can be re-applied to the same layout any number of times
+struct mutation {
+    mutation_type type;
+    uint8_t offs;           //  index into COFFS, for Shift
+    uint16_t idx1, idx2;    //  the positions (the range's ends for Shift)
+    uint16_t var1, var2;    //  the new variants, for Reroll
+};
+
+//  the mutations applied to the working layout, with an undo log, so the layout
+//  can be restored without copying it over from the parent
+class mutation_log {
+public:
+    std::vector<mutation> ops;
+
+    //  the indices of the changed positions (may repeat)
+    std::vector<int> changed;
+
+    //  layout_key of the mutated layout, kept up to date if it was set for the original one
+    uint64_t key;
+
+    mutation_log() : key(0), base_key(0) {}
+
+    void set_key(uint64_t _key) {
+        key = base_key = _key;
+    }
+
+    void reserve(int max_ops, int max_changed) {
+        ops.reserve(max_ops);
+        changed.reserve(max_changed);
+        undo_log.reserve(max_changed);
+    }
+
+    void clear() {
+        ops.clear();
+        changed.clear();
+        undo_log.clear();
+        key = base_key;
+    }
+
+    //  applies the mutation to the layout, recording it in the log
+    void apply(layout_ref target, const mutation& m) {
+        ops.push_back(m);
+        for_each_changed(m, [&](int i) {
+            changed.push_back(i);
+            undo_log.push_back({i, target[i]});
+            key ^= position_key(i, target[i]);
+        });
+        mutation_log::redo(target, m);
+        for_each_changed(m, [&](int i) { key ^= position_key(i, target[i]); });
+    }
+
+    //  restores the layout to the state before the logged mutations, and clears the log
+    void undo(layout_ref target) {
+        for (auto it = undo_log.rbegin(); it != undo_log.rend(); ++it) target[it->first] = it->second;
+        clear();
+    }
+
+    //  applies the mutation without logging it
+    static void redo(layout_ref target, const mutation& m) {
+        if (m.type == mutation_type::Reroll) {
+            target[m.idx1].var_idx = m.var1;
+            target[m.idx2].var_idx = m.var2;
+        } else if (m.type == mutation_type::Shift) {
+            const vec2i& offs = COFFS[m.offs];
+            for (int k = m.idx1; k <= m.idx2; k++) {
+                target[k].x += offs.x;
+                target[k].y += offs.y;
+            }
+        } else if (m.type == mutation_type::Swap) {
+            std::swap(target[m.idx1].shape_idx, target[m.idx2].shape_idx);
+            std::swap(target[m.idx1].var_idx, target[m.idx2].var_idx);
+        }
+    }
+
+    static void redo(layout_ref target, const std::vector<mutation>& ops) {
+        for (const mutation& m : ops) redo(target, m);
+    }
+
+    //  calls fn(i) once for every position index the mutation touches
+    template <typename TFn>
+    static void for_each_changed(const mutation& m, TFn fn) {
+        if (m.type == mutation_type::Shift) {
+            for (int k = m.idx1; k <= m.idx2; k++) fn(k);
+        } else {
+            fn(m.idx1);
+            if (m.idx2 != m.idx1) fn(m.idx2);
+        }
+    }
+
+private:
+    std::vector<std::pair<int, shape_pos>> undo_log;
+    uint64_t base_key;
+};
+
+//  picks the mutation types and the number of flips uniformly
+struct uniform_ops {
+    int min_flips, max_flips;
+
+    int pick_flips(philox_rng& rng) const { return (int)rng.below(max_flips - min_flips + 1) + min_flips; }
+    mutation_type pick_type(philox_rng& rng) const { return (mutation_type)rng.below(3); }
+};
+
+//  applies a few random mutations to the layout, recording them in the log,
+//  ops.pick_flips(rng)/ops.pick_type(rng) decide how many and which ones
+template <typename TOps>
+inline void mutate(const shape::variation_array& variations, const TOps& ops,
+    layout_ref target, mutation_log& log, philox_rng& rng)
+{
+    const int nshapes = (int)target.size();
+
+    int num_flips = ops.pick_flips(rng);
+    for (int i = 0; i < num_flips; i++) {
+        mutation m = {};
+        m.type = ops.pick_type(rng);
+        m.idx1 = (uint16_t)rng.below(nshapes);
+        m.idx2 = (uint16_t)rng.below(nshapes);
+
+        if (m.type == mutation_type::Reroll) {
+            m.var1 = (uint16_t)rng.below((uint32_t)variations[target[m.idx1].shape_idx].size());
+            m.var2 = (uint16_t)rng.below((uint32_t)variations[target[m.idx2].shape_idx].size());
+        } else if (m.type == mutation_type::Shift) {
+            m.offs = (uint8_t)rng.below(8);
+        }
+        log.apply(target, m);
+    }
+}
+
+inline void mutate(const shape::variation_array& variations, int min_flips, int max_flips,
+    layout_ref target, mutation_log& log, philox_rng& rng)
+{
+    mutate(variations, uniform_ops{min_flips, max_flips}, target, log, rng);
+}
+
+#endif // __MUTATION__
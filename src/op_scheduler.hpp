@@ -0,0 +1,196 @@
+#ifndef __OP_SCHEDULER__
+#define __OP_SCHEDULER__
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#include <philox.hpp>
+#include <mutation.hpp>
+
+//  the outcomes of the candidates per mutation type and per number of flips,
+//  gathered by every worker separately and merged between the iterations
+struct op_stats {
+    static const int NUM_TYPES = 3;
+    static const int MAX_FLIP_ARMS = 16;
+
+    struct arm {
+        uint64_t uses;          //  the candidates that had the operator in them
+        uint64_t improvements;  //  the ones of them that got better than their parent
+        int64_t gain;           //  the sum of their improvements (the scores are integer)
+    };
+
+    arm types[NUM_TYPES];
+    arm flips[MAX_FLIP_ARMS];   //  by num_flips - min_flips
+
+    op_stats() { clear(); }
+
+    void clear() {
+        std::fill(types, types + NUM_TYPES, arm{0, 0, 0});
+        std::fill(flips, flips + MAX_FLIP_ARMS, arm{0, 0, 0});
+    }
+
+    void add(const op_stats& rhs) {
+        for (int i = 0; i < NUM_TYPES; i++) add(types[i], rhs.types[i]);
+        for (int i = 0; i < MAX_FLIP_ARMS; i++) add(flips[i], rhs.flips[i]);
+    }
+
+    //  records a scored candidate produced by the given mutations,
+    //  the parents with no real score (the duplicates pushed to the bottom) are skipped
+    void record(const std::vector<mutation>& ops, int min_flips, double score, double parent_score) {
+        if (parent_score == -std::numeric_limits<double>::max()) return;
+        const int64_t gain = (int64_t)(score - parent_score);
+        for (const mutation& m : ops) hit(types[(int)m.type], gain);
+        hit(flips[std::min((int)ops.size() - min_flips, MAX_FLIP_ARMS - 1)], gain);
+    }
+
+private:
+    static void add(arm& a, const arm& b) {
+        a.uses += b.uses;
+        a.improvements += b.improvements;
+        a.gain += b.gain;
+    }
+
+    static void hit(arm& a, int64_t gain) {
+        a.uses++;
+        if (gain > 0) {
+            a.improvements++;
+            a.gain += gain;
+        }
+    }
+};
+
+//  picks the mutation types and the number of flips per candidate, multi-armed bandit style:
+//  every arm's average gain per use gets tracked over the iterations (as a moving average),
+//  and the probabilities are matched to it, with a floor for the exploration.
+//  The probabilities only change in update(), between the iterations, from the integer counts
+//  summed over the workers, so the choices still only depend on the random streams, whatever the threads.
+//  When not adaptive, the choices are exactly the same as the uniform_ops' ones.
+class op_scheduler {
+public:
+    struct arm {
+        double rate;        //  moving average of the gain per use
+        double prob;
+        uint64_t bound;     //  the arm is picked when the 32 random bits are below it (and not below the previous one)
+    };
+
+    //  everything update() changes, plain data so that the checkpoints can store it as is
+    struct state {
+        int32_t min_flips, max_flips;
+        int32_t num_flip_arms;
+        int32_t reserved;
+        arm types[op_stats::NUM_TYPES];
+        arm flips[op_stats::MAX_FLIP_ARMS];
+        op_stats totals;
+    };
+
+    op_scheduler(int _min_flips, int _max_flips, bool _adaptive = false, double _min_prob = 0.05, double _decay = 0.3) :
+        min_flips(_min_flips), max_flips(std::min(_max_flips, _min_flips + op_stats::MAX_FLIP_ARMS - 1)),
+        adaptive(_adaptive), min_prob(_min_prob), decay(_decay)
+    {
+        type_arms.resize(op_stats::NUM_TYPES);
+        flip_arms.resize(max_flips - min_flips + 1);
+        set_uniform(type_arms);
+        set_uniform(flip_arms);
+    }
+
+    int get_min_flips() const { return min_flips; }
+    int get_max_flips() const { return max_flips; }
+    bool is_adaptive() const { return adaptive; }
+
+    mutation_type pick_type(philox_rng& rng) const {
+        return (mutation_type)pick(type_arms, rng());
+    }
+
+    int pick_flips(philox_rng& rng) const {
+        return min_flips + pick(flip_arms, rng());
+    }
+
+    //  takes in the statistics of an iteration (merged over the workers), and adapts the probabilities
+    void update(const op_stats& iter) {
+        totals.add(iter);
+        if (!adaptive) return;
+        adapt(type_arms, iter.types);
+        adapt(flip_arms, iter.flips);
+    }
+
+    //  everything since the start
+    const op_stats& get_totals() const { return totals; }
+
+    state get_state() const {
+        state res = {};
+        res.min_flips = min_flips;
+        res.max_flips = max_flips;
+        res.num_flip_arms = (int32_t)flip_arms.size();
+        std::copy(type_arms.begin(), type_arms.end(), res.types);
+        std::copy(flip_arms.begin(), flip_arms.end(), res.flips);
+        res.totals = totals;
+        return res;
+    }
+
+    //  continues from the saved state, so that the choices are the same as they would be in the run
+    //  that saved it. The arms start over if the range of the flips has changed since.
+    void set_state(const state& st) {
+        totals = st.totals;
+        std::copy(st.types, st.types + op_stats::NUM_TYPES, type_arms.begin());
+        if (st.min_flips == min_flips && st.max_flips == max_flips && st.num_flip_arms == (int)flip_arms.size()) {
+            std::copy(st.flips, st.flips + flip_arms.size(), flip_arms.begin());
+        } else {
+            set_uniform(type_arms);
+            set_uniform(flip_arms);
+        }
+    }
+
+    double type_prob(int type) const { return type_arms[type].prob; }
+    double flips_prob(int num_flips) const { return flip_arms[num_flips - min_flips].prob; }
+
+private:
+    int min_flips, max_flips;
+    bool adaptive;
+    double min_prob;
+    double decay;
+
+    std::vector<arm> type_arms;
+    std::vector<arm> flip_arms;
+    op_stats totals;
+
+    static int pick(const std::vector<arm>& arms, uint32_t r) {
+        const int n = (int)arms.size();
+        for (int i = 0; i < n - 1; i++) {
+            if (r < arms[i].bound) return i;
+        }
+        return n - 1;
+    }
+
+    //  the same bounds as the multiply-shift in philox_rng::below() has
+    static void set_uniform(std::vector<arm>& arms) {
+        const uint64_t n = arms.size();
+        for (uint64_t i = 0; i < n; i++) {
+            arms[i].rate = 0;
+            arms[i].prob = 1.0/n;
+            arms[i].bound = (((i + 1) << 32) + n - 1)/n;
+        }
+    }
+
+    void adapt(std::vector<arm>& arms, const op_stats::arm* stats) const {
+        const int n = (int)arms.size();
+        double total = 0;
+        for (int i = 0; i < n; i++) {
+            const double rate = stats[i].uses ? (double)stats[i].gain/stats[i].uses : 0.0;
+            arms[i].rate = arms[i].rate*(1 - decay) + rate*decay;
+            total += arms[i].rate;
+        }
+        if (total <= 0) return;
+
+        const double floor = std::min(min_prob, 1.0/n);
+        double cum = 0;
+        for (int i = 0; i < n; i++) {
+            arms[i].prob = floor + (1 - n*floor)*arms[i].rate/total;
+            cum += arms[i].prob;
+            arms[i].bound = (i == n - 1) ? (uint64_t(1) << 32) : (uint64_t)(cum*4294967296.0);
+        }
+    }
+};
+
+#endif // __OP_SCHEDULER__
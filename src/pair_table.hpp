@@ -0,0 +1,140 @@
+#ifndef __PAIR_TABLE__
+#define __PAIR_TABLE__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <limits>
+#include <cassert>
+#include <chrono>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+#include <fixed_shape.hpp>
+
+//  precomputed distance() between every pair of shape variants,
+//  for all the relative offsets within [-window, window] on both axes
+//  (the window gets capped so that the distances fit into int8_t, see get_window())
+class pair_table {
+public:
+    pair_table(const shape::variation_array& _variations, int _window) :
+        variations(_variations), window(_window)
+    {
+        using namespace std::chrono;
+        high_resolution_clock::time_point start_time = high_resolution_clock::now();
+
+        //  every variant gets a global index
+        num_vars = 0;
+        int max_ext = 0;
+        for (const auto& vars : variations) {
+            var_offset.push_back(num_vars);
+            num_vars += (int)vars.size();
+            for (const shape& sh : vars) max_ext = std::max(max_ext, std::max(sh.width, sh.height));
+        }
+        //  the window has to contain all the overlapping offsets, and the distances within it are int8_t:
+        //  they are at most 2*(window + max_ext - 1) - 1, so the window can't go past 64 - max_ext
+        window = std::max(std::min(window, 64 - max_ext), max_ext);
+        assert(2*(window + max_ext - 1) - 1 <= std::numeric_limits<int8_t>::max());
+        side = 2*window + 1;
+
+        std::vector<const shape*> var_shapes;
+        for (const auto& vars : variations) {
+            for (const shape& sh : vars) var_shapes.push_back(&sh);
+        }
+
+        //  for the same-order sets the distances outside of the window go through fixed_distance
+        order = dispatch_order(shape::order(variations), [](auto n) { return decltype(n)::value; });
+        if (order != 0) {
+            for (const shape* sh : var_shapes) {
+                var_squares.insert(var_squares.end(), sh->squares.begin(), sh->squares.end());
+            }
+        }
+
+        //  distance(sh1, d, sh2, 0) is the manhattan distance from d to the nearest
+        //  of the (sq2 - sq1) offsets, minus one, so it's a distance transform
+        dist.resize((size_t)num_vars*num_vars*side*side);
+        std::vector<int> grid(side*side);
+        for (int v1 = 0; v1 < num_vars; v1++) {
+            for (int v2 = 0; v2 < num_vars; v2++) {
+                std::fill(grid.begin(), grid.end(), side*2);
+                for (const auto& sq1 : var_shapes[v1]->squares) {
+                    for (const auto& sq2 : var_shapes[v2]->squares) {
+                        grid[(sq2.x - sq1.x + window) + (sq2.y - sq1.y + window)*side] = 0;
+                    }
+                }
+                distance_transform(grid);
+                int8_t* cell = &dist[((size_t)v1*num_vars + v2)*side*side];
+                for (int i = 0; i < side*side; i++) cell[i] = (int8_t)(grid[i] - 1);
+            }
+        }
+
+        auto int_ms = duration_cast<std::chrono::milliseconds>(high_resolution_clock::now() - start_time);
+        build_ms = (int)int_ms.count();
+    }
+
+    //  same as distance() for two placed shapes
+    inline int operator ()(const shape_pos& pos1, const shape_pos& pos2) const {
+        const int dx = pos1.x - pos2.x + window;
+        const int dy = pos1.y - pos2.y + window;
+        const int v1 = var_offset[pos1.shape_idx] + pos1.var_idx;
+        const int v2 = var_offset[pos2.shape_idx] + pos2.var_idx;
+        if (dx < 0 || dy < 0 || dx >= side || dy >= side) {
+            if (order == 0) {
+                return distance(variations[pos1.shape_idx][pos1.var_idx], pos1.p(),
+                    variations[pos2.shape_idx][pos2.var_idx], pos2.p());
+            }
+            const vec2i* sq1 = &var_squares[v1*order];
+            const vec2i* sq2 = &var_squares[v2*order];
+            const vec2i d = pos1.p() - pos2.p();
+            return dispatch_order(order, [&](auto n) { return fixed_distance<decltype(n)::value>(sq1, d, sq2); });
+        }
+        return dist[(((size_t)v1*num_vars + v2)*side + dy)*side + dx];
+    }
+
+    //  same as overlap_status() for two placed shapes
+    inline overlap overlap_status(const shape_pos& pos1, const shape_pos& pos2) const {
+        int d = (*this)(pos1, pos2);
+        if (d < 0) return overlap::Overlap;
+        if (d == 0) return overlap::Border;
+        return overlap::Disjoint;
+    }
+
+    int get_window() const { return window; }
+    int get_num_vars() const { return num_vars; }
+    int get_build_ms() const { return build_ms; }
+    int get_order() const { return order; }
+    size_t memory_size() const { return dist.size()*sizeof(dist[0]); }
+
+private:
+    const shape::variation_array& variations;
+    int window, side;
+    int num_vars;
+    int build_ms;
+    std::vector<int> var_offset;
+    std::vector<int8_t> dist;
+
+    //  the shapes' order if it's specialized (see dispatch_order), 0 otherwise
+    int order;
+    //  the variants' squares, order per variant, in the global variant order
+    std::vector<vec2i> var_squares;
+
+    //  in-place manhattan distance transform of the side x side grid
+    void distance_transform(std::vector<int>& grid) const {
+        for (int y = 0; y < side; y++) {
+            for (int x = 0; x < side; x++) {
+                int& d = grid[x + y*side];
+                if (x > 0) d = std::min(d, grid[x - 1 + y*side] + 1);
+                if (y > 0) d = std::min(d, grid[x + (y - 1)*side] + 1);
+            }
+        }
+        for (int y = side - 1; y >= 0; y--) {
+            for (int x = side - 1; x >= 0; x--) {
+                int& d = grid[x + y*side];
+                if (x < side - 1) d = std::min(d, grid[x + 1 + y*side] + 1);
+                if (y < side - 1) d = std::min(d, grid[x + (y + 1)*side] + 1);
+            }
+        }
+    }
+};
+
+#endif // __PAIR_TABLE__
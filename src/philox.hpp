@@ -0,0 +1,73 @@
+#ifndef __PHILOX__
+#define __PHILOX__
+
+#include <cstdint>
+
+//  Philox4x32-10 counter-based generator (Salmon et al., "Parallel random numbers: as easy as 1, 2, 3"):
+//  the output is a pure function of the 128-bit counter and the 64-bit key,
+//  so any point of any stream can be computed without going through the ones before it
+inline void philox4x32(const uint32_t counter[4], const uint32_t key[2], uint32_t out[4]) {
+    const uint32_t M0 = 0xD2511F53, M1 = 0xCD9E8D57;
+    const uint32_t W0 = 0x9E3779B9, W1 = 0xBB67AE85;
+
+    uint32_t c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    uint32_t k0 = key[0], k1 = key[1];
+    for (int r = 0; r < 10; r++) {
+        const uint64_t p0 = (uint64_t)M0*c0;
+        const uint64_t p1 = (uint64_t)M1*c2;
+        const uint32_t n0 = (uint32_t)(p1 >> 32) ^ c1 ^ k0;
+        const uint32_t n2 = (uint32_t)(p0 >> 32) ^ c3 ^ k1;
+        c1 = (uint32_t)p1;
+        c3 = (uint32_t)p0;
+        c0 = n0;
+        c2 = n2;
+        k0 += W0;
+        k1 += W1;
+    }
+    out[0] = c0;
+    out[1] = c1;
+    out[2] = c2;
+    out[3] = c3;
+}
+
+//  a random stream keyed by (seed, iteration, child, retry): all the streams are independent,
+//  and each one can be reproduced on its own, on any thread.
+//  Can be used wherever the standard library expects a uniform random bit generator.
+class philox_rng {
+public:
+    typedef uint32_t result_type;
+
+    philox_rng(uint64_t seed, uint32_t iteration, uint32_t child, uint32_t retry) : pos(4) {
+        key[0] = (uint32_t)seed;
+        key[1] = (uint32_t)(seed >> 32);
+        counter[0] = 0;
+        counter[1] = iteration;
+        counter[2] = child;
+        counter[3] = retry;
+    }
+
+    static constexpr result_type min() { return 0; }
+    static constexpr result_type max() { return 0xFFFFFFFF; }
+
+    result_type operator ()() {
+        if (pos == 4) {
+            philox4x32(counter, key, block);
+            counter[0]++;
+            pos = 0;
+        }
+        return block[pos++];
+    }
+
+    //  uniform in [0, n), via the multiply-shift instead of the (more biased) modulo
+    uint32_t below(uint32_t n) {
+        return (uint32_t)(((uint64_t)(*this)()*n) >> 32);
+    }
+
+private:
+    uint32_t key[2];
+    uint32_t counter[4];
+    uint32_t block[4];
+    int pos;
+};
+
+#endif // __PHILOX__
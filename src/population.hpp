@@ -0,0 +1,426 @@
+#ifndef __POPULATION__
+#define __POPULATION__
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <functional>
+
+#include <shape.hpp>
+#include <shape_library.hpp>
+#include <layout_arena.hpp>
+#include <pair_table.hpp>
+#include <eval_context.hpp>
+#include <philox.hpp>
+#include <mutation.hpp>
+#include <op_scheduler.hpp>
+#include <layout_hash.hpp>
+#include <score_cache.hpp>
+#include <selection.hpp>
+#include <circle_seeder.hpp>
+
+//  the genetic algorithm parameters
+struct ga_config {
+    int generation_size;
+    int num_elite;
+    double mutated_share;       //  the part of the generation produced by mutating the parents
+    int num_retries;            //  mutated candidates per child, the best one of them wins
+    int min_flips, max_flips;   //  mutations per candidate
+    int retry_block_size;       //  see eval_context
+    uint64_t seed;
+
+    //  whether the rotated/reflected copies of a layout count as duplicates
+    bool canonical_dihedral = true;
+    //  whether the duplicates within a generation get pushed to the bottom of the ranking
+    bool unique_generation = false;
+    //  whether the mutation types and the number of flips get picked by how well they've been doing
+    //  (see op_scheduler), rather than uniformly
+    bool adaptive_ops = false;
+
+    selection_method selection = selection_method::Rank;
+    int tournament_size = 4;
+    int rank_buckets = 16;
+    //  how many of the best ones are kept in order, when the generation isn't fully sorted
+    int sorted_head = 100;
+};
+
+//  the "retry" part of the random stream key used for picking the parent and shuffling,
+//  the mutation retries get their own streams with the keys 0..num_retries - 1
+static const uint32_t RNG_PICK_STREAM = 0xFFFFFFFF;
+
+//  a single evolving population of layouts.
+//  The passes over the children go through for_each(n, fn), which has to call fn(i, worker)
+//  for every i in [0, n), using contexts[worker] as the scratch state - so the same code
+//  runs both on a thread pool and serially. The results only depend on the config's seed,
+//  the iteration and the child's index (offset by child_offset, to tell apart several populations).
+//  The scores get looked up in the (optional, possibly shared) cache before evaluating.
+//  The generations are two layout_arenas, swapped between the iterations, and the ranking
+//  refers to the current one's rows by their indices.
+class population {
+public:
+    struct lscore {
+        int idx;        //  the row in the current generation
+        double score;
+        bool operator <(const lscore& rhs) const {return score > rhs.score; }
+    };
+
+    population(const shape_library& _lib, const pair_table& _table, double _radius,
+        const ga_config& _cfg, int _child_offset = 0, score_cache* _cache = nullptr) :
+        lib(_lib), variations(_lib.get_variations()), table(_table), seeder(_lib, _radius, _table), cfg(_cfg),
+        child_offset(_child_offset), cache(_cache), evals(0), scores(_cfg.generation_size),
+        hasher(_lib.get_variations(), _cfg.canonical_dihedral),
+        sched(_cfg.min_flips, _cfg.max_flips, _cfg.adaptive_ops)
+    {
+        cur_gen.resize(cfg.generation_size, (int)variations.size());
+        prev_gen.resize(cfg.generation_size, (int)variations.size());
+        num_mutated = std::min((int)(cfg.generation_size*cfg.mutated_share), cfg.generation_size - cfg.num_elite);
+        hashes.resize(cfg.generation_size);
+        seen.reserve(cfg.unique_generation ? cfg.generation_size : cfg.num_elite);
+        init_selection();
+    }
+
+    population(const population&) = delete;
+    population& operator =(const population&) = delete;
+
+    int size() const { return cfg.generation_size; }
+    double best_score() const { return scores[0].score; }
+
+    //  the number of the layouts scored so far (including the ones found in the cache)
+    size_t num_evals() const { return evals; }
+
+    //  the current generation, from the best to the worst - unless the selection method is not Rank,
+    //  then only the first sorted_head ones are in order, followed by the rest (all worse than them)
+    const std::vector<lscore>& ranked() const { return scores; }
+
+    //  the i-th layout of ranked()
+    const_layout_ref layout(int i) const { return cur_gen.row(scores[i].idx); }
+
+    //  the bytes taken by both generations' layouts and scores
+    size_t memory_size() const { return cur_gen.memory_size() + prev_gen.memory_size(); }
+
+    //  the mutation operators' probabilities and statistics
+    const op_scheduler& get_scheduler() const { return sched; }
+
+    //  seeds the first generation
+    template <typename TFor>
+    void init(std::vector<eval_context>& contexts, TFor&& for_each) {
+        const int nshapes = (int)variations.size();
+        for_each(cfg.generation_size, [&](int k, int worker) {
+            eval_context& ctx = contexts[worker];
+            layout_ref pos = cur_gen.row(k);
+            for (int i = 0; i < nshapes; i++) pos[i] = {0, 0, (uint16_t)i, 0};
+
+            //std::random_shuffle(pos.begin(), pos.end());
+            seeder.arrange(pos, table);
+            cur_gen.score(k) = lib.score(pos, table, ctx.board, ctx.method);
+        });
+        collect_scores();
+        rank();
+        evals += cfg.generation_size;
+    }
+
+    //  produces the next generation
+    template <typename TFor>
+    void step(int it, std::vector<eval_context>& contexts, TFor&& for_each) {
+        const int gen_size = cfg.generation_size;
+        const int nshapes = (int)variations.size();
+        cur_gen.swap(prev_gen);
+
+        int ii = 0;
+        //  transfer the "elite" ones (making sure there is no duplicates)
+        seen.clear();
+        for (int i = 0; i < gen_size; i++) {
+            const_layout_ref pos = prev_gen.row(scores[i].idx);
+            if (seen.insert(hasher(pos))) std::copy(pos.begin(), pos.end(), cur_gen.row(ii++).begin());
+            if (ii == cfg.num_elite) break;
+        }
+
+        //  apply the mutations
+        const int num_elite = ii;
+        for_each(num_mutated, [&](int i, int worker) {
+            eval_context& ctx = contexts[worker];
+            const int child = num_elite + i;
+            philox_rng pick_rng(cfg.seed, it, child_offset + child, RNG_PICK_STREAM);
+
+            // pick the source gene
+            int idx = pick_parent(pick_rng);
+            const_layout_ref src = prev_gen.row(scores[idx].idx);
+            const double src_score = scores[idx].score;
+            layout_ref dst = cur_gen.row(child);
+
+            double max_score = -std::numeric_limits<double>::max();
+
+            //  the retries mutate the working copy in place and then undo the changes,
+            //  only the best one's mutations are kept, to be re-applied to the parent at the end
+            ctx.target.assign(src.begin(), src.end());
+            ctx.log.set_key(cache ? layout_key(src) : 0);
+            ctx.log.clear();
+            ctx.best_ops.clear();
+            if (cfg.retry_block_size > 1) {
+                const int nslots = std::min(cfg.retry_block_size, cfg.num_retries);
+                for (int k = 0; k < nslots; k++) ctx.block.set(k, src);
+
+                for (int ii = 0; ii < cfg.num_retries; ii += cfg.retry_block_size) {
+                    //  only the ones missing from the cache go into the block
+                    const int nblock = std::min(cfg.retry_block_size, cfg.num_retries - ii);
+                    int nmissed = 0;
+                    for (int k = 0; k < nblock; k++) {
+                        philox_rng rng(cfg.seed, it, child_offset + child, ii + k);
+                        mutate(variations, sched, ctx.target, ctx.log, rng);
+                        ctx.block_ops[k] = ctx.log.ops;
+                        ctx.retry_keys[k] = ctx.log.key;
+                        if (!cached_score(ctx, ctx.log.key, ctx.retry_scores[k])) {
+                            ctx.retry_slots[k] = nmissed;
+                            for (int i : ctx.log.changed) ctx.block.set(nmissed, i, ctx.target[i]);
+                            nmissed++;
+                        } else {
+                            ctx.retry_slots[k] = -1;
+                        }
+                        ctx.log.undo(ctx.target);
+                    }
+
+                    ctx.batch.score(ctx.block, nmissed, ctx.block_scores.data());
+                    for (int k = 0; k < nblock; k++) {
+                        const int slot = ctx.retry_slots[k];
+                        if (slot >= 0) {
+                            ctx.retry_scores[k] = ctx.block_scores[slot];
+                            if (cache) cache->insert(ctx.retry_keys[k], ctx.retry_scores[k], it);
+
+                            //  back to the parent
+                            for (const mutation& m : ctx.block_ops[k]) {
+                                mutation_log::for_each_changed(m, [&](int i) { ctx.block.set(slot, i, src[i]); });
+                            }
+                        }
+                        ctx.ops_stats.record(ctx.block_ops[k], cfg.min_flips, ctx.retry_scores[k], src_score);
+                        if (ctx.retry_scores[k] > max_score) {
+                            max_score = ctx.retry_scores[k];
+                            ctx.best_ops = ctx.block_ops[k];
+                        }
+                    }
+                }
+            } else {
+                ctx.eval.set_parent(src);
+                for (int ii = 0; ii < cfg.num_retries; ii++) {
+                    philox_rng rng(cfg.seed, it, child_offset + child, ii);
+                    mutate(variations, sched, ctx.target, ctx.log, rng);
+
+                    double score;
+                    if (!cached_score(ctx, ctx.log.key, score)) {
+                        score = ctx.eval.score(ctx.target, ctx.log.changed);
+                        if (cache) cache->insert(ctx.log.key, score, it);
+                    }
+                    ctx.ops_stats.record(ctx.log.ops, cfg.min_flips, score, src_score);
+                    if (score > max_score) {
+                        max_score = score;
+                        ctx.best_ops = ctx.log.ops;
+                    }
+                    ctx.log.undo(ctx.target);
+                }
+            }
+
+            std::copy(src.begin(), src.end(), dst.begin());
+            mutation_log::redo(dst, ctx.best_ops);
+        });
+        ii += num_mutated;
+
+        //  pad the rest with the fresh ones
+        const int num_kept = ii;
+        for_each(gen_size - num_kept, [&](int k, int) {
+            philox_rng rng(cfg.seed, it, child_offset + num_kept + k, RNG_PICK_STREAM);
+            layout_ref pos = cur_gen.row(num_kept + k);
+            for (int i = 0; i < nshapes; i++) pos[i] = {0, 0, (uint16_t)i, 0};
+            std::shuffle(pos.begin(), pos.end(), rng);
+            seeder.arrange(pos, table);
+        });
+
+        //  score the current generation
+        for_each(gen_size, [&](int k, int worker) {
+            eval_context& ctx = contexts[worker];
+            layout_ref pos = cur_gen.row(k);
+            double& score = cur_gen.score(k);
+            lib.center(pos);
+            const uint64_t key = cache ? layout_key(pos) : 0;
+            if (!cached_score(ctx, key, score)) {
+                score = lib.score(pos, table, ctx.board, ctx.method);
+                if (cache) cache->insert(key, score, it);
+            }
+            if (cfg.unique_generation) hashes[k] = hasher(pos);
+        });
+
+        if (cfg.unique_generation) {
+            seen.clear();
+            for (int k = 0; k < gen_size; k++) {
+                if (!seen.insert(hashes[k])) cur_gen.score(k) = -std::numeric_limits<double>::max();
+            }
+        }
+        collect_scores();
+        rank();
+        evals += (size_t)num_mutated*cfg.num_retries + gen_size;
+
+        //  the operators' probabilities for the next iteration, the sums don't depend on the order
+        iter_ops.clear();
+        for (eval_context& ctx : contexts) {
+            iter_ops.add(ctx.ops_stats);
+            ctx.ops_stats.clear();
+        }
+        sched.update(iter_ops);
+    }
+
+    //  replaces the generation with the n given layouts, going from the best one (get(i, layout) copies out
+    //  the i-th of them into the given layout_ref and returns its score): the worst ones get dropped if there are more than fits,
+    //  and if there are less, the rest is filled with the fresh ones, keyed by the iteration "it".
+    //  The operators continue from the given state.
+    template <typename TGet, typename TFor>
+    void restore(int n, TGet&& get, int it, const op_scheduler::state& ops, std::vector<eval_context>& contexts,
+        TFor&& for_each)
+    {
+        sched.set_state(ops);
+        const int gen_size = cfg.generation_size;
+        const int nshapes = (int)variations.size();
+        const int nkept = std::min(n, gen_size);
+        for (int k = 0; k < nkept; k++) cur_gen.score(k) = get(k, cur_gen.row(k));
+        if (nkept == gen_size) {
+            collect_scores();
+            return;
+        }
+
+        for_each(gen_size - nkept, [&](int k, int worker) {
+            eval_context& ctx = contexts[worker];
+            philox_rng rng(cfg.seed, it, child_offset + nkept + k, RNG_PICK_STREAM);
+            layout_ref pos = cur_gen.row(nkept + k);
+            for (int i = 0; i < nshapes; i++) pos[i] = {0, 0, (uint16_t)i, 0};
+            std::shuffle(pos.begin(), pos.end(), rng);
+            seeder.arrange(pos, table);
+            lib.center(pos);
+            cur_gen.score(nkept + k) = lib.score(pos, table, ctx.board, ctx.method);
+        });
+        collect_scores();
+        rank();
+        evals += gen_size - nkept;
+    }
+
+    //  copies out up to n best distinct layouts into the front of res, returns their number
+    int get_best(int n, std::vector<std::vector<shape_pos>>& res) {
+        if ((int)res.size() < n) res.resize(n);
+        int k = 0;
+        seen.clear();
+        for (int i = 0; i < cfg.generation_size && k < n; i++) {
+            const_layout_ref pos = layout(i);
+            if (seen.insert(hasher(pos))) res[k++].assign(pos.begin(), pos.end());
+        }
+        return k;
+    }
+
+    //  replaces the worst layouts of the current generation with the first n of the given ones
+    void replace_worst(const std::vector<std::vector<shape_pos>>& layouts, int n, eval_context& ctx) {
+        n = std::min(n, cfg.generation_size - cfg.num_elite);
+        if (n <= 0) return;
+        if (cfg.selection != selection_method::Rank) {
+            std::nth_element(scores.begin(), scores.end() - n, scores.end());
+        }
+        for (int i = 0; i < n; i++) {
+            lscore& s = scores[cfg.generation_size - 1 - i];
+            layout_ref pos = cur_gen.row(s.idx);
+            std::copy(layouts[i].begin(), layouts[i].end(), pos.begin());
+            s.score = cur_gen.score(s.idx) = lib.score(pos, table, ctx.board, ctx.method);
+        }
+        rank();
+        evals += n;
+    }
+
+private:
+    const shape_library& lib;
+    const shape::variation_array& variations;
+    const pair_table& table;
+    circle_seeder seeder;
+    ga_config cfg;
+    int child_offset;
+    int num_mutated;
+    score_cache* cache;
+    size_t evals;
+
+    layout_arena cur_gen;
+    layout_arena prev_gen;
+    std::vector<lscore> scores;
+
+    //  for telling apart the duplicates
+    layout_hasher hasher;
+    hash_set seen;
+    std::vector<uint64_t> hashes;
+
+    op_scheduler sched;
+    op_stats iter_ops;
+
+    //  RankBuckets: the offsets the generation gets partitioned at (the bucket bounds and the sorted head's end),
+    //  and the buckets' probabilities
+    std::vector<int> rank_bounds;
+    std::vector<int> bucket_starts;
+    alias_table buckets;
+
+    void init_selection() {
+        const int n = cfg.generation_size;
+        if (cfg.selection != selection_method::RankBuckets) return;
+        const int nbuckets = std::max(1, std::min(cfg.rank_buckets, n));
+        std::vector<double> weights(nbuckets);
+        bucket_starts.resize(nbuckets + 1);
+        for (int b = 0; b <= nbuckets; b++) bucket_starts[b] = (int)((int64_t)b*n/nbuckets);
+        for (int b = 0; b < nbuckets; b++) {
+            //  the Rank's pick is sqrt of uniform in [0, n^2), so P(idx < x) = x^2/n^2
+            const double lo = bucket_starts[b], hi = bucket_starts[b + 1];
+            weights[b] = hi*hi - lo*lo;
+        }
+        buckets.build(weights.data(), nbuckets);
+
+        rank_bounds.assign(bucket_starts.begin() + 1, bucket_starts.end() - 1);
+        rank_bounds.push_back(std::min(cfg.sorted_head, n));
+        std::sort(rank_bounds.begin(), rank_bounds.end());
+        rank_bounds.erase(std::unique(rank_bounds.begin(), rank_bounds.end()), rank_bounds.end());
+    }
+
+    //  the ranking of the current generation as it is, before rank()
+    void collect_scores() {
+        for (int k = 0; k < cfg.generation_size; k++) scores[k] = {k, cur_gen.score(k)};
+    }
+
+    //  puts the best ones first, see ranked()
+    void rank() {
+        switch (cfg.selection) {
+        case selection_method::Tournament:
+            sort_head(scores.begin(), scores.end(), cfg.sorted_head, std::less<lscore>());
+            break;
+        case selection_method::RankBuckets:
+            partition_at(scores.begin(), scores.end(), rank_bounds.data(), (int)rank_bounds.size(), std::less<lscore>());
+            std::sort(scores.begin(), scores.begin() + std::min(cfg.sorted_head, cfg.generation_size));
+            break;
+        default:
+            std::sort(scores.begin(), scores.end());
+        }
+    }
+
+    int pick_parent(philox_rng& rng) const {
+        const int n = cfg.generation_size;
+        switch (cfg.selection) {
+        case selection_method::Tournament:
+            return tournament(n, cfg.tournament_size, rng, [this](int a, int b) { return scores[a] < scores[b]; });
+        case selection_method::RankBuckets: {
+            const int b = buckets.sample(rng);
+            return bucket_starts[b] + (int)rng.below(bucket_starts[b + 1] - bucket_starts[b]);
+        }
+        default:
+            return rank_pick(n, rng);
+        }
+    }
+
+    //  looks up the score of the layout with the given layout_key in the cache
+    bool cached_score(eval_context& ctx, uint64_t key, double& score) const {
+        if (!cache) return false;
+        ctx.cache_lookups++;
+        if (!cache->find(key, score)) return false;
+        ctx.cache_hits++;
+        return true;
+    }
+};
+
+#endif // __POPULATION__
@@ -5,7 +5,8 @@
 #include <vector>
 #include <string>
 #include <sstream>
-#include <map>
+#include <algorithm>
+#include <cstdint>
 
 class rect_contour {
 public:
@@ -44,73 +45,61 @@ public:
     rect_contour() {}
     rect_contour(const chain_vec& _chains) : chains(_chains) {}
 
+    //  traces the contours around the set pixels, clockwise, scaling the points by ext.
+    //  With join_diagonals the pixels touching by a corner get into the same contour, otherwise
+    //  the contours just touch there. The points of a chain are its corners only.
     inline void trace_bitmap(const std::vector<bool>& pixels, int bitmap_width, 
         point ext = {1, 1}, bool join_diagonals = true) {
 
-        //  extract edges of every pixel's square, clockwise
-        std::vector<edge> edges;
-        const size_t npixels = pixels.size();
-        for (size_t i = 0; i < npixels; i++) {
-            if (pixels[i]) {
-                int cx = i%bitmap_width;
-                int cy = ((int)i)/bitmap_width;
-                edges.push_back({{ext.x*(cx    ), ext.y*(cy    )}, {ext.x*(cx + 1), ext.y*(cy    )}});
-                edges.push_back({{ext.x*(cx + 1), ext.y*(cy    )}, {ext.x*(cx + 1), ext.y*(cy + 1)}});
-                edges.push_back({{ext.x*(cx + 1), ext.y*(cy + 1)}, {ext.x*(cx    ), ext.y*(cy + 1)}});
-                edges.push_back({{ext.x*(cx    ), ext.y*(cy + 1)}, {ext.x*(cx    ), ext.y*(cy    )}});
-            }
+        if (pixels.empty()) return;
+        const int npixels = (int)pixels.size();
+        const int h = (npixels + bitmap_width - 1)/bitmap_width;
+        trace_grid([&](int x, int y) {
+            const int i = x + y*bitmap_width;
+            return i < npixels && pixels[i];
+        }, bitmap_width, h, {0, 0}, ext, join_diagonals);
+    }
+
+    //  same as trace_bitmap, but for the explicit list of the set cells (must have no duplicates)
+    inline void trace_cells(const std::vector<point>& cells, point ext = {1, 1}, bool join_diagonals = true) {
+        if (cells.empty()) return;
+        point lt = cells[0], rb = cells[0];
+        for (const point& c : cells) {
+            lt.x = std::min(lt.x, c.x);
+            lt.y = std::min(lt.y, c.y);
+            rb.x = std::max(rb.x, c.x);
+            rb.y = std::max(rb.y, c.y);
         }
+        const int w = rb.x - lt.x + 1;
+        const int h = rb.y - lt.y + 1;
+        std::vector<bool> pixels((size_t)w*h, false);
+        for (const point& c : cells) pixels[(c.x - lt.x) + (size_t)(c.y - lt.y)*w] = true;
+        trace_grid([&](int x, int y) { return pixels[x + (size_t)y*w]; }, w, h, lt, ext, join_diagonals);
+    }
 
-        //  insert into the endpoints registry, eliminating double edges on the way
-        std::multimap<point, edge*> start_points;
-        for (auto& e : edges) {
-            auto er = start_points.equal_range(e.b);
-            bool present = false;
-            for (auto it = er.first; it != er.second; ++it) {
-                const edge* pe = it->second;
-                if (pe->b == e.a) {
-                    //  have the same edge, going in opposite direction
-                    //  - cancel it out
-                    start_points.erase(it);
-                    present = true;
-                    break;
-                }
-            }
-            if (!present) start_points.emplace(e.a, &e);
+    //  doubled signed area of the chain (shoelace formula),
+    //  positive for the outer contours and negative for the holes
+    static inline int signed_area2(const chain& c) {
+        int res = 0;
+        const size_t np = c.size();
+        for (size_t i = 0; i < np; i++) {
+            const point& a = c[i];
+            const point& b = c[(i + 1)%np];
+            res += a.x*b.y - b.x*a.y;
         }
+        return res;
+    }
 
-        //  traverse the contours, collapsing aligned segments
-        edge cur_edge = { {-1, -1}, {-1, -1 } };
-        while (!start_points.empty()) {
-            auto er = start_points.equal_range(cur_edge.b);
-            if (er.first == er.second || chains.empty()) {
-                //  start new chain inside the rect_contour
-                cur_edge.a = cur_edge.b = start_points.begin()->first;
-                chains.push_back({cur_edge.a});
-                continue;
-            }
-            auto it = er.first;
-            auto it1 = it;
-            ++it1;
-            if (it1 != er.second) {
-                //  at this point we still may have more than one outgoing edge, e.g:
-                //  o|
-                //   |o
-                const edge* pe = it1->second;
-                if (are_clockwise(cur_edge, *pe) == join_diagonals) it = it1;
-                ++it1;
-                assert(it1 == er.second);
-            }
-            const edge* pe = it->second;
-            std::vector<point>& cc = chains.back();
-            if (are_collinear(cur_edge, *pe)) {
-                cur_edge.b = pe->b;
-            } else {
-                cc.push_back({cur_edge.b});
-                cur_edge = *pe;
-            }
-            start_points.erase(it);
+    //  tests if the point is inside of the chain, the point must not lie on the chain itself
+    static inline bool contains(const chain& c, double x, double y) {
+        bool res = false;
+        const size_t np = c.size();
+        for (size_t i = 0; i < np; i++) {
+            const point& a = c[i];
+            const point& b = c[(i + 1)%np];
+            if (a.x == b.x && a.x > x && (a.y < y) != (b.y < y)) res = !res;
         }
+        return res;
     }
 
     std::string svg_path() const {
@@ -148,6 +137,64 @@ public:
     }
 
     chain_vec chains;
+
+private:
+    //  walks the pixel edges over the (w + 1) x (h + 1) grid of the pixels' corners, so it takes
+    //  linear time in the number of pixels. Every corner gets a bit per direction of the edge going
+    //  out of it (keeping the set pixel on the right), and the walk clears the bits it passes.
+    //  The chains start from the corners in the order of x, then y, same as the contours always did.
+    template <typename TIsSet>
+    void trace_grid(TIsSet is_set, int w, int h, point org, point ext, bool join_diagonals) {
+        enum { RIGHT, DOWN, LEFT, UP };
+        static const int DX[] = {1, 0, -1, 0};
+        static const int DY[] = {0, 1, 0, -1};
+
+        auto cell = [&](int x, int y) { return x >= 0 && y >= 0 && x < w && y < h && is_set(x, y); };
+
+        const int gw = w + 1;
+        std::vector<uint8_t> out((size_t)gw*(h + 1), 0);
+        for (int y = 0; y <= h; y++) {
+            for (int x = 0; x <= w; x++) {
+                const bool tl = cell(x - 1, y - 1), tr = cell(x, y - 1);
+                const bool bl = cell(x - 1, y), br = cell(x, y);
+                uint8_t m = 0;
+                if (br && !tr) m |= 1 << RIGHT;
+                if (bl && !br) m |= 1 << DOWN;
+                if (tl && !bl) m |= 1 << LEFT;
+                if (tr && !tl) m |= 1 << UP;
+                out[x + (size_t)y*gw] = m;
+            }
+        }
+
+        auto to_point = [&](int x, int y) { return point{ext.x*(org.x + x), ext.y*(org.y + y)}; };
+        for (int sx = 0; sx <= w; sx++) {
+            for (int sy = 0; sy <= h; sy++) {
+                if (out[sx + (size_t)sy*gw] == 0) continue;
+
+                //  goes on until there is no way out of the corner, which is only back at the start
+                chain c = {to_point(sx, sy)};
+                int x = sx, y = sy, dir = -1;
+                while (true) {
+                    uint8_t& m = out[x + (size_t)y*gw];
+                    if (m == 0) break;
+                    int d = 0;
+                    while (!(m & (1 << d))) d++;
+                    if ((m & (m - 1)) && dir >= 0) {
+                        //  two ways out, between the pixels touching by the corner: 
+                        //  turn towards the set one to join them, or away from it
+                        const int cp = DX[dir]*DY[d] - DY[dir]*DX[d];
+                        if ((cp < 0) != join_diagonals) d = (d + 2)%4;
+                    }
+                    m &= ~(1 << d);
+                    if (dir >= 0 && d != dir) c.push_back(to_point(x, y));
+                    dir = d;
+                    x += DX[d];
+                    y += DY[d];
+                }
+                chains.push_back(std::move(c));
+            }
+        }
+    }
 };
 
 
@@ -0,0 +1,131 @@
+#include <fstream>
+#include <cstdio>
+
+#include <checkpoint.h>
+#include <result_writer.h>
+
+result_writer::result_writer(const shape::variation_array& _variations, const layout_hasher& _hasher,
+    const std::string& _path, int min_interval_ms, int _max_layouts, int _cell_side) :
+    variations(_variations), hasher(_hasher), path(_path), min_interval(min_interval_ms),
+    max_layouts(_max_layouts), cell_side(_cell_side), has_pending(false), flushing(false), stopping(false),
+    posted_seq(0), done_seq(0), written(0), unchanged(0), paths(_variations), has_written(false), written_key(0)
+{
+    const size_t n = (size_t)max_layouts*variations.size();
+    for (snapshot* snap : {&staging, &pending, &current}) {
+        snap->positions.reserve(n);
+        snap->count = 0;
+        snap->key = 0;
+    }
+    seen.reserve(max_layouts);
+    last_write = std::chrono::steady_clock::now() - min_interval;
+    thread = std::thread([this]() { run(); });
+}
+
+result_writer::~result_writer() {
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        stopping = true;
+    }
+    wake_cv.notify_all();
+    thread.join();
+}
+
+void result_writer::post(const std::vector<const_layout_ref>& ranked) {
+    //  same selection as the html always had: the first max_layouts distinct ones
+    staging.positions.clear();
+    staging.count = 0;
+    staging.key = 0;
+    seen.clear();
+    for (size_t k = 0; k < ranked.size() && staging.count < max_layouts; k++) {
+        const_layout_ref pos = ranked[k];
+        if (!seen.insert(hasher(pos))) continue;
+        staging.positions.insert(staging.positions.end(), pos.begin(), pos.end());
+        staging.count++;
+        staging.key = mix64(staging.key ^ layout_key(pos));
+    }
+
+    {
+        std::lock_guard<std::mutex> guard(lock);
+        std::swap(staging, pending);
+        has_pending = true;
+        posted_seq++;
+    }
+    wake_cv.notify_all();
+}
+
+void result_writer::flush() {
+    std::unique_lock<std::mutex> guard(lock);
+    flushing = true;
+    wake_cv.notify_all();
+    done_cv.wait(guard, [this]() { return done_seq == posted_seq; });
+    flushing = false;
+}
+
+int result_writer::num_written() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return written;
+}
+
+int result_writer::num_unchanged() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return unchanged;
+}
+
+void result_writer::run() {
+    std::unique_lock<std::mutex> guard(lock);
+    while (true) {
+        wake_cv.wait(guard, [this]() { return has_pending || stopping; });
+        if (!has_pending) break;
+
+        //  the newer snapshots keep replacing the pending one while waiting out the interval
+        if (!stopping && !flushing) {
+            wake_cv.wait_until(guard, last_write + min_interval, [this]() { return stopping || flushing; });
+        }
+        std::swap(pending, current);
+        has_pending = false;
+        const uint64_t seq = posted_seq;
+        guard.unlock();
+
+        const bool changed = !has_written || current.key != written_key;
+        const bool ok = changed && write(current);
+        if (ok) {
+            has_written = true;
+            written_key = current.key;
+            last_write = std::chrono::steady_clock::now();
+        }
+
+        guard.lock();
+        if (ok) written++;
+        if (!changed) unchanged++;
+        done_seq = seq;
+        done_cv.notify_all();
+    }
+}
+
+bool result_writer::write(const snapshot& snap) {
+    const std::string tmp_path = path + ".tmp";
+    std::ofstream ofs(tmp_path);
+    if (!ofs) return false;
+    ofs << "<div>\n";
+
+    const size_t nshapes = variations.size();
+    for (int k = 0; k < snap.count; k++) {
+        const_layout_ref pos(&snap.positions[k*nshapes], nshapes);
+        shape core;
+        vec2i core_pos;
+        bool has_core = shape::extract_core(variations, pos, core, core_pos);
+        if (has_core) {
+            create_svg(ofs, paths, pos, &core, &core_pos, cell_side);
+        } else {
+            create_svg(ofs, paths, pos, nullptr, nullptr, cell_side);
+        }
+    }
+
+    ofs << "</div>\n";
+    ofs.close();
+    if (!ofs) {
+        std::remove(tmp_path.c_str());
+        return false;
+    }
+    return replace_file(tmp_path, path);
+}
@@ -0,0 +1,83 @@
+#ifndef __RESULT_WRITER_H__
+#define __RESULT_WRITER_H__
+
+#include <vector>
+#include <string>
+#include <cstdint>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <chrono>
+
+#include <shape.hpp>
+#include <layout_hash.hpp>
+#include <svg_gen.h>
+
+//  renders the best layouts into the html file on a thread of its own, so the solver never waits for it.
+//  post() only picks the distinct best layouts and copies them into the pending snapshot (replacing
+//  the previous one if it didn't get written yet), and the writer thread renders it if it differs from
+//  the last written one, no more often than once per min_interval_ms. The file is written to a temporary
+//  one first, which then gets renamed over it, so there is always a complete one there.
+class result_writer {
+public:
+    result_writer(const shape::variation_array& variations, const layout_hasher& hasher, const std::string& path,
+        int min_interval_ms, int max_layouts = 100, int cell_side = 15);
+
+    //  writes out the pending snapshot (if any) and stops the thread
+    ~result_writer();
+
+    result_writer(const result_writer&) = delete;
+    result_writer& operator =(const result_writer&) = delete;
+
+    //  takes a snapshot of the best layouts, ranked from the best one, doesn't wait for the rendering
+    void post(const std::vector<const_layout_ref>& ranked);
+
+    //  waits until the last posted snapshot is written out, regardless of the interval
+    void flush();
+
+    //  how many times the file got written, and how many snapshots were skipped as the same as the written one
+    int num_written() const;
+    int num_unchanged() const;
+
+private:
+    struct snapshot {
+        std::vector<shape_pos> positions;   //  count layouts, nshapes positions each
+        int count;
+        uint64_t key;                       //  tells apart the different sets of layouts
+    };
+
+    const shape::variation_array& variations;
+    const layout_hasher& hasher;
+    std::string path;
+    std::chrono::milliseconds min_interval;
+    int max_layouts;
+    int cell_side;
+
+    //  filled by post() on the caller's thread, then swapped with the pending one
+    snapshot staging;
+    hash_set seen;
+
+    //  everything below is guarded by the lock
+    mutable std::mutex lock;
+    std::condition_variable wake_cv, done_cv;
+    snapshot pending;
+    bool has_pending;
+    bool flushing;
+    bool stopping;
+    uint64_t posted_seq, done_seq;
+    int written, unchanged;
+
+    //  only touched by the writer thread
+    snapshot current;
+    svg_path_cache paths;
+    bool has_written;
+    uint64_t written_key;
+    std::chrono::steady_clock::time_point last_write;
+
+    std::thread thread;
+
+    void run();
+    bool write(const snapshot& snap);
+};
+
+#endif
@@ -0,0 +1,135 @@
+#ifndef __RUN_CONTROL__
+#define __RUN_CONTROL__
+
+#include <atomic>
+#include <chrono>
+#include <csignal>
+#include <limits>
+#include <algorithm>
+
+//  when a run has to stop
+struct run_limits {
+    int max_iter;
+    double time_budget;         //  seconds of the wall time, 0 means no limit
+    int stagnation_iter;        //  iterations without any improvement of the best score, 0 means no limit
+};
+
+enum class stop_reason {
+    None        = 0,
+    MaxIter     = 1,
+    Deadline    = 2,
+    Stagnation  = 3,
+    Signal      = 4,
+    MaxNodes    = 5,
+};
+
+inline const char* to_string(stop_reason reason) {
+    switch (reason) {
+    case stop_reason::MaxIter:      return "max iterations";
+    case stop_reason::Deadline:     return "time budget";
+    case stop_reason::Stagnation:   return "stagnation";
+    case stop_reason::Signal:       return "interrupted";
+    case stop_reason::MaxNodes:     return "node budget";
+    default:                        return "running";
+    }
+}
+
+//  decides whether to run the next iteration: an iteration only starts if it's expected to fit
+//  into the time budget, judging by the cost of the previous ones, so the run never overshoots
+//  the deadline by a whole iteration. SIGINT/SIGTERM (once catch_signals() was called) make the
+//  run stop after the current iteration, so the results can still be written out.
+class run_controller {
+public:
+    explicit run_controller(const run_limits& _limits) :
+        limits(_limits), best_score(-std::numeric_limits<double>::max()), since_improved(0),
+        last_cost(0), avg_cost(0), reason(stop_reason::None)
+    {
+        start();
+    }
+
+    void start() {
+        start_time = clock::now();
+        iter_start = start_time;
+    }
+
+    //  seconds since the start
+    double elapsed() const {
+        return std::chrono::duration<double>(clock::now() - start_time).count();
+    }
+
+    //  called before the it-th iteration, also starts measuring its cost
+    bool keep_going(int it) {
+        if (interrupted()) reason = stop_reason::Signal;
+        else if (it >= limits.max_iter) reason = stop_reason::MaxIter;
+        else if (stagnated(since_improved)) reason = stop_reason::Stagnation;
+        else if (!has_time_for(std::max(last_cost, avg_cost))) reason = stop_reason::Deadline;
+        iter_start = clock::now();
+        return reason == stop_reason::None;
+    }
+
+    //  called after an iteration, with the best score so far
+    void iteration_done(double score) {
+        last_cost = std::chrono::duration<double>(clock::now() - iter_start).count();
+        avg_cost = (avg_cost == 0) ? last_cost : avg_cost*0.8 + last_cost*0.2;
+        if (score > best_score) {
+            best_score = score;
+            since_improved = 0;
+        } else {
+            since_improved++;
+        }
+    }
+
+    //  whether something taking the given number of seconds still fits into the budget,
+    //  can be called from any thread (for the loops that measure their iterations themselves)
+    bool has_time_for(double cost) const {
+        if (interrupted()) return false;
+        return limits.time_budget <= 0 || elapsed() + cost <= limits.time_budget;
+    }
+
+    //  whether this many iterations without an improvement are enough to stop,
+    //  for the loops that track their best scores themselves
+    bool stagnated(int iters) const {
+        return limits.stagnation_iter > 0 && iters >= limits.stagnation_iter;
+    }
+
+    stop_reason get_reason() const { return reason; }
+
+    //  records why the run stopped, for the loops that don't go through keep_going()
+    void set_reason(stop_reason _reason) { reason = _reason; }
+
+    //  the iterations since the best score last improved
+    int get_stagnation() const { return since_improved; }
+
+    static void catch_signals() {
+        std::signal(SIGINT, on_signal);
+        std::signal(SIGTERM, on_signal);
+    }
+
+    static bool interrupted() { return signal_flag() != 0; }
+
+private:
+    typedef std::chrono::high_resolution_clock clock;
+
+    run_limits limits;
+    clock::time_point start_time;
+    clock::time_point iter_start;
+
+    double best_score;
+    int since_improved;
+
+    //  seconds, of the last iteration and the running average
+    double last_cost, avg_cost;
+
+    stop_reason reason;
+
+    static volatile std::sig_atomic_t& signal_flag() {
+        static volatile std::sig_atomic_t flag = 0;
+        return flag;
+    }
+
+    static void on_signal(int) {
+        signal_flag() = 1;
+    }
+};
+
+#endif // __RUN_CONTROL__
@@ -0,0 +1,92 @@
+#ifndef __SCORE_CACHE__
+#define __SCORE_CACHE__
+
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+//  a concurrent transposition table from the layout keys (see layout_key) to their scores.
+//  The entries are grouped into the cache line sized buckets, and each entry keeps
+//  (key ^ data, data), so a reader that sees a half-written entry (from a concurrent writer)
+//  just gets a miss, and there are no locks at all. When a bucket is full, the entry written
+//  at the oldest iteration gets replaced.
+class score_cache {
+public:
+    static const int BUCKET_SIZE = 4;
+
+    explicit score_cache(size_t max_bytes) {
+        size_t nbuckets = 1;
+        while (nbuckets*2*sizeof(bucket) <= max_bytes) nbuckets *= 2;
+        num_buckets = nbuckets;
+        buckets.reset(new bucket[nbuckets]);
+    }
+
+    score_cache(const score_cache&) = delete;
+    score_cache& operator =(const score_cache&) = delete;
+
+    size_t memory_size() const { return num_buckets*sizeof(bucket); }
+    size_t capacity() const { return num_buckets*BUCKET_SIZE; }
+
+    bool find(uint64_t key, double& score) const {
+        const bucket& b = buckets[key & (num_buckets - 1)];
+        for (int i = 0; i < BUCKET_SIZE; i++) {
+            const uint64_t data = b.entries[i].data.load(std::memory_order_relaxed);
+            const uint64_t check = b.entries[i].check.load(std::memory_order_relaxed);
+            if ((check ^ data) == key && data != 0) {
+                score = (double)(int32_t)(uint32_t)data;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    //  the scores have to be integer, "iteration" is the time stamp used for the replacement
+    void insert(uint64_t key, double score, int iteration) {
+        bucket& b = buckets[key & (num_buckets - 1)];
+        const uint16_t stamp = (uint16_t)iteration;
+        int victim = 0, max_age = -1;
+        for (int i = 0; i < BUCKET_SIZE; i++) {
+            const uint64_t data = b.entries[i].data.load(std::memory_order_relaxed);
+            const uint64_t check = b.entries[i].check.load(std::memory_order_relaxed);
+            if (data == 0 || (check ^ data) == key) {
+                victim = i;
+                break;
+            }
+            const int age = (uint16_t)(stamp - (uint16_t)(data >> 32));
+            if (age > max_age) {
+                max_age = age;
+                victim = i;
+            }
+        }
+
+        //  the stamp is kept away from 0, so that a valid entry is never all zeros
+        const uint64_t data = ((uint64_t)(stamp | 0x10000) << 32) | (uint32_t)(int32_t)score;
+        b.entries[victim].data.store(data, std::memory_order_relaxed);
+        b.entries[victim].check.store(key ^ data, std::memory_order_relaxed);
+    }
+
+    void clear() {
+        for (size_t i = 0; i < num_buckets; i++) {
+            for (auto& e : buckets[i].entries) {
+                e.data.store(0, std::memory_order_relaxed);
+                e.check.store(0, std::memory_order_relaxed);
+            }
+        }
+    }
+
+private:
+    struct entry {
+        std::atomic<uint64_t> check;
+        std::atomic<uint64_t> data;
+        entry() : check(0), data(0) {}
+    };
+
+    struct bucket {
+        entry entries[BUCKET_SIZE];
+    };
+
+    size_t num_buckets;
+    std::unique_ptr<bucket[]> buckets;
+};
+
+#endif // __SCORE_CACHE__
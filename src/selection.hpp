@@ -0,0 +1,126 @@
+#ifndef __SELECTION__
+#define __SELECTION__
+
+#include <vector>
+#include <cstdint>
+#include <algorithm>
+#include <cmath>
+
+#include <philox.hpp>
+
+//  how the parents get picked from the ranked generation
+enum class selection_method {
+    Rank        = 0,    //  by the rank, with the full sort of the generation
+    Tournament  = 1,    //  the best of a few picked at random, the generation's order doesn't matter
+    RankBuckets = 2,    //  same distribution as Rank, but only over the rank buckets (quantiles), so no full sort
+};
+
+//  Vose's alias method: samples the indices [0, n) with the probabilities proportional
+//  to the given weights, in constant time. Building it is linear (and doesn't allocate
+//  once the table got its size).
+class alias_table {
+public:
+    int size() const { return (int)prob.size(); }
+
+    void build(const double* weights, int n) {
+        prob.resize(n);
+        alias.resize(n);
+        scaled.resize(n);
+        small.clear();
+        large.clear();
+        small.reserve(n);
+        large.reserve(n);
+
+        double total = 0;
+        for (int i = 0; i < n; i++) total += weights[i];
+        for (int i = 0; i < n; i++) {
+            scaled[i] = weights[i]*n/total;
+            alias[i] = i;
+            (scaled[i] < 1.0 ? small : large).push_back(i);
+        }
+        while (!small.empty() && !large.empty()) {
+            int s = small.back(), l = large.back();
+            small.pop_back();
+            prob[s] = to_threshold(scaled[s]);
+            alias[s] = l;
+            scaled[l] -= 1.0 - scaled[s];
+            if (scaled[l] < 1.0) {
+                large.pop_back();
+                small.push_back(l);
+            }
+        }
+        //  whatever is left is 1 up to the rounding errors
+        for (int i : small) prob[i] = UINT32_MAX;
+        for (int i : large) prob[i] = UINT32_MAX;
+    }
+
+    int sample(philox_rng& rng) const {
+        const int i = (int)rng.below((uint32_t)prob.size());
+        return (rng() < prob[i]) ? i : alias[i];
+    }
+
+private:
+    //  the column's own index is taken if the second random number is below prob[i]
+    std::vector<uint32_t> prob;
+    std::vector<int> alias;
+
+    //  the scratch space of build()
+    std::vector<double> scaled;
+    std::vector<int> small, large;
+
+    static uint32_t to_threshold(double p) {
+        return (p >= 1.0) ? UINT32_MAX : (uint32_t)(p*4294967296.0);
+    }
+};
+
+//  rearranges [first, last) so that every bounds[i] (the offsets, ascending) splits it into
+//  the ones coming before it and the ones that don't, without sorting the parts themselves,
+//  in O(n log(number of bounds))
+template <typename TIter, typename TLess>
+void partition_at(TIter first, TIter last, const int* bounds, int nbounds, TLess less, int base = 0) {
+    if (nbounds == 0 || last - first < 2) return;
+    const int mid = nbounds/2;
+    const TIter nth = first + (bounds[mid] - base);
+    if (nth >= last) {
+        partition_at(first, last, bounds, mid, less, base);
+        return;
+    }
+    std::nth_element(first, nth, last, less);
+    partition_at(first, nth, bounds, mid, less, base);
+    partition_at(nth + 1, last, bounds + mid + 1, nbounds - mid - 1, less, bounds[mid] + 1);
+}
+
+//  only the first "head" elements end up sorted, the rest just comes after them
+template <typename TIter, typename TLess>
+void sort_head(TIter first, TIter last, int head, TLess less) {
+    if (head >= last - first) {
+        std::sort(first, last, less);
+        return;
+    }
+    std::nth_element(first, first + head, last, less);
+    std::sort(first, first + head, less);
+}
+
+//  the index of the best one (by less) of the "size" ones picked at random from [0, n)
+template <typename TLess>
+int tournament(int n, int size, philox_rng& rng, TLess less) {
+    int best = (int)rng.below(n);
+    for (int i = 1; i < size; i++) {
+        const int idx = (int)rng.below(n);
+        if (less(idx, best)) best = idx;
+    }
+    return best;
+}
+
+//  the Rank selection's pick from [0, n): sqrt of uniform in [0, n^2), so P(idx < x) = x^2/n^2.
+//  Past n = 65535 the n^2 doesn't fit the 32 bits any more, then it takes 53 random bits instead
+inline int rank_pick(int n, philox_rng& rng) {
+    const uint64_t nn = (uint64_t)n*n;
+    if (nn <= 0xFFFFFFFF) return (int)sqrt((double)rng.below((uint32_t)nn));
+    const uint64_t hi = rng();
+    const uint64_t lo = rng() >> 11;
+    const double u = (double)((hi << 21) | lo)*(1.0/9007199254740992.0);
+    return std::min((int)(n*sqrt(u)), n - 1);
+}
+
+#endif // __SELECTION__
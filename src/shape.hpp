@@ -3,13 +3,18 @@
 
 #include <vector>
 #include <string>
+#include <cstdint>
 #include <iostream>
 #include <algorithm>
 #include <numeric>
+#include <limits>
 #include <queue>
 #include <cassert>
+#include <cmath>
 
 #include <vec2.hpp>
+#include <bitboard.hpp>
+#include <rect_contour.hpp>
 
 const double PI = 3.14159265358979323846;
 const double MAX_DIST = 1e5;
@@ -36,11 +41,21 @@ enum class overlap {
     Disjoint    = 2,    //  shapes neither overlap nor have a common edge
 };
 
+enum class area_method {
+    FloodFill   = 0,    //  flood-fill the enclosed space, proportional to its area
+    Contour     = 1,    //  trace the contours of the shapes, proportional to their perimeter
+};
+
+//  the layouts stay within a few hundred cells around the origin, so the coordinates fit into 16 bits
 struct shape_pos {
-    int x, y;
+    int16_t x, y;
     uint16_t shape_idx; 
     uint16_t var_idx; 
 
+    static shape_pos at(const vec2i& p, int shape_idx, int var_idx) {
+        return {(int16_t)p.x, (int16_t)p.y, (uint16_t)shape_idx, (uint16_t)var_idx};
+    }
+
     vec2i p() const { return {x, y}; }
     bool operator == (const shape_pos& rhs) const {
         return x == rhs.x && y == rhs.y && 
@@ -48,6 +63,35 @@ struct shape_pos {
     }
 };
 
+//  a layout stored somewhere else (in a vector, or in a row of a layout_arena), without owning it
+template <typename T>
+class layout_span {
+public:
+    layout_span() : ptr(nullptr), n(0) {}
+    layout_span(T* _ptr, size_t _n) : ptr(_ptr), n(_n) {}
+    layout_span(std::vector<shape_pos>& v) : ptr(v.data()), n(v.size()) {}
+    layout_span(const std::vector<shape_pos>& v) : ptr(v.data()), n(v.size()) {}
+    template <typename U>
+    layout_span(const layout_span<U>& rhs) : ptr(rhs.data()), n(rhs.size()) {}
+
+    T* data() const { return ptr; }
+    size_t size() const { return n; }
+    T* begin() const { return ptr; }
+    T* end() const { return ptr + n; }
+    T& operator [](size_t i) const { return ptr[i]; }
+
+    bool operator ==(const layout_span<const shape_pos>& rhs) const {
+        return n == rhs.size() && std::equal(ptr, ptr + n, rhs.data());
+    }
+
+private:
+    T* ptr;
+    size_t n;
+};
+
+typedef layout_span<shape_pos> layout_ref;
+typedef layout_span<const shape_pos> const_layout_ref;
+
 struct shape {
     typedef std::vector< std::vector<shape> > variation_array;
 
@@ -65,6 +109,9 @@ struct shape {
 
     bool operator ==(const shape& rhs) const { return width == rhs.width && mask == rhs.mask; }
 
+    //  the empty cells sharing an edge with the shape
+    const std::vector<vec2i>& get_boundary() const { return boundary; }
+
     shape mirrored() const {
         shape res;
         size_t nsq = squares.size();
@@ -148,19 +195,39 @@ struct shape {
         }
         return res;
     }
+
+    //  returns the number of squares if it's the same for all the shapes, 0 otherwise
+    static int order(const variation_array& variations) {
+        size_t n = 0;
+        for (const auto& vars : variations) {
+            for (const shape& sh : vars) {
+                if (n != 0 && sh.squares.size() != n) return 0;
+                n = sh.squares.size();
+            }
+        }
+        return (int)n;
+    }
     
     //  returns manhattan distance between two shapes' squares
     // -1 if they overlap, 0 if border
     friend int distance(const shape& sh1, const vec2i& pos1, 
         const shape& sh2, const vec2i& pos2) 
     {
-        overlap ov = overlap_status(sh1, pos1, sh2, pos2);
-        if (ov == overlap::Border) return 0;
-        if (ov == overlap::Overlap) return -1;
-
         int dx = pos1.x - pos2.x;
         int dy = pos1.y - pos2.y;
 
+        if (!sh1.rows.empty() && !sh2.rows.empty()) {
+            //  find the smallest dilation of the second shape that hits the first one
+            if (rows_intersect(sh1.rows, dx, dy, sh2.rows)) return -1;
+            for (int r = 1; r <= MAX_DILATION; r++) {
+                if (rows_intersect(sh1.rows, dx + r, dy + r, sh2.dilated[r - 1])) return r - 1;
+            }
+        } else {
+            overlap ov = overlap_status(sh1, pos1, sh2, pos2);
+            if (ov == overlap::Border) return 0;
+            if (ov == overlap::Overlap) return -1;
+        }
+
         int min_dist = std::numeric_limits<int>::max();
         for (const auto& sq1 : sh1.squares) {
             const int x = sq1.x  + dx;
@@ -182,6 +249,12 @@ struct shape {
         
         int dx = pos1.x - pos2.x;
         int dy = pos1.y - pos2.y;
+
+        if (!sh1.rows.empty() && !sh2.rows.empty()) {
+            if (rows_intersect(sh1.rows, dx, dy, sh2.rows)) return overlap::Overlap;
+            if (rows_intersect(sh1.rows, dx + 1, dy + 1, sh2.dilated[0])) return overlap::Border;
+            return overlap::Disjoint;
+        }
    
         //  test for overlapping
         for (const auto& sq : sh1.squares) {
@@ -237,11 +310,10 @@ struct shape {
             for (const auto& bpos : boundary) {
                 for (const auto& cpos : sh.squares) {
                     vec2i p = pos + bpos - cpos;
-                    double d = fit_fn(p, sh);
+                    shape_pos cand = shape_pos::at(p, res.shape_idx, var);
+                    double d = fit_fn(cand, sh);
                     if (d < min_d) {
-                        res.x = p.x;
-                        res.y = p.y;
-                        res.var_idx = var;
+                        res = cand;
                         min_d = d;
                     }
                 }
@@ -249,8 +321,27 @@ struct shape {
         }
     }
 
+    //  measures the distance between two placed shapes directly
+    struct direct_distance {
+        const variation_array& variations;
+
+        int operator ()(const shape_pos& pos1, const shape_pos& pos2) const {
+            return distance(variations[pos1.shape_idx][pos1.var_idx], pos1.p(), 
+                variations[pos2.shape_idx][pos2.var_idx], pos2.p());
+        }
+    };
+
+    static void arrange_circle(double radius, const variation_array& variations, 
+        layout_ref positions) 
+    {
+        arrange_circle(radius, variations, positions, direct_distance{variations});
+    }
+
+    //  dist_fn(pos1, pos2) is expected to give the same result as distance() for the placed shapes.
+    //  This is the plain version, circle_seeder gives the same layouts a lot faster
+    template <typename TDistFn>
     static void arrange_circle(double radius, const variation_array& variations, 
-        std::vector<shape_pos>& positions) 
+        layout_ref positions, const TDistFn& dist_fn) 
     {
         const int nshapes = (int)variations.size();
         assert(positions.size() == nshapes);
@@ -259,8 +350,8 @@ struct shape {
             if (i == 0) {
                 shape_pos& pos = positions[i];
                 const shape& sh = variations[pos.shape_idx][0];
-                pos.x = (int)round(radius - sh.width*0.5);
-                pos.y = (int)round(-sh.height*0.5);
+                pos.x = (int16_t)round(radius - sh.width*0.5);
+                pos.y = (int16_t)round(-sh.height*0.5);
                 pos.var_idx = 0;
             } else {
                 const shape_pos& prev_pos = positions[i - 1];
@@ -268,17 +359,16 @@ struct shape {
                 const auto prev_angles = prev_shape.angle_range(prev_pos.p());
 
                 int k = i%nshapes;
-                const auto vars = variations[positions[k].shape_idx];
+                const auto& vars = variations[positions[k].shape_idx];
                 prev_shape.best_fit(positions[k], prev_pos.p(), vars, 
-                    [&](const vec2i& p, const shape& sh){
+                    [&](const shape_pos& cand, const shape& sh){
+                    const vec2i p = cand.p();
                     if (i == nshapes) {
                         int i1 = (i + 1)%nshapes;
-                        const shape_pos& next_pos = positions[i1];
-                        const shape& next_shape = variations[next_pos.shape_idx][next_pos.var_idx];
-                        int d1 = distance(sh, p, next_shape, next_pos.p());
+                        int d1 = dist_fn(cand, positions[i1]);
                         if (d1 != 0) return MAX_DIST + abs(d1);
                     } 
-                    int d = distance(sh, p, prev_shape, prev_pos.p());
+                    int d = dist_fn(cand, prev_pos);
                     if (d != 0) return MAX_DIST;
 
                     auto angles = sh.angle_range(p);
@@ -291,25 +381,38 @@ struct shape {
 
     }
 
-    static double score(const variation_array& variations, const std::vector<shape_pos>& positions) {
+    static double score(const variation_array& variations, const_layout_ref positions) {
+        return score(variations, positions, direct_distance{variations});
+    }
+
+    template <typename TDistFn>
+    static double score(const variation_array& variations, const_layout_ref positions, 
+        const TDistFn& dist_fn) 
+    {
+        bitboard board;
+        return score(variations, positions, dist_fn, board);
+    }
+
+    //  same as above, using the given board as the scratch space
+    template <typename TDistFn>
+    static double score(const variation_array& variations, const_layout_ref positions, 
+        const TDistFn& dist_fn, bitboard& board, area_method method = area_method::FloodFill) 
+    {
         //  find the are of the closed space
-        int area = flood_fill(variations, positions, [](int, int){});
+        int area = (method == area_method::Contour) ? contour_area(variations, positions) :
+            flood_fill(variations, positions, [](int, int){}, board);
         if (area > 0) return area;
         double dist = 0.0;
         const size_t nshapes = variations.size();
         for (int i = 0; i < nshapes; i++) {
-            const shape_pos& pos1 = positions[i];
-            const shape_pos& pos2 = positions[(i + 1)%nshapes];
-            const shape& sh1 = variations[pos1.shape_idx][pos1.var_idx];
-            const shape& sh2 = variations[pos2.shape_idx][pos2.var_idx];
-            dist += abs(distance(sh1, pos1.p(), sh2, pos2.p()));
+            dist += abs(dist_fn(positions[i], positions[(i + 1)%nshapes]));
         }
 
         return -dist;
     }
 
     static void get_bounds(const variation_array& variations, 
-        const std::vector<shape_pos>& positions, vec2i& lt, vec2i& rb) 
+        const_layout_ref positions, vec2i& lt, vec2i& rb) 
     {
         lt = {std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
         rb = {std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
@@ -318,14 +421,14 @@ struct shape {
         for (int i = 0; i < n; i++) {
             const shape_pos& pos = positions[i];
             const shape& sh = variations[pos.shape_idx][pos.var_idx];
-            lt.x = std::min(lt.x, pos.x);
-            lt.y = std::min(lt.y, pos.y);
+            lt.x = std::min(lt.x, (int)pos.x);
+            lt.y = std::min(lt.y, (int)pos.y);
             rb.x = std::max(rb.x, pos.x + sh.width);
             rb.y = std::max(rb.y, pos.y + sh.height);
         }
     }
 
-    static void center(const variation_array& variations, std::vector<shape_pos>& positions) 
+    static void center(const variation_array& variations, layout_ref positions) 
     {
         vec2i lt, rb;
         get_bounds(variations, positions, lt, rb);
@@ -339,32 +442,38 @@ struct shape {
 
     template <typename TFn>
     static int flood_fill(const variation_array& variations, 
-        const std::vector<shape_pos>& positions, TFn hit_fn)
+        const_layout_ref positions, TFn hit_fn)
+    {
+        bitboard board;
+        return flood_fill(variations, positions, hit_fn, board);
+    }
+
+    template <typename TFn>
+    static int flood_fill(const variation_array& variations, 
+        const_layout_ref positions, TFn hit_fn, bitboard& board)
     {
         vec2i lt, rb;
         get_bounds(variations, positions, lt, rb);
         int w = rb.x - lt.x + 1;
         int h = rb.y - lt.y + 1;
 
-        //  create the mask
+        //  rasterize the shapes
         const int n = (int)variations.size();
-        std::vector<char> mask(w*h, 0);
+        board.reset(w, h);
         for (int i = 0; i < n; i++) {
             const shape_pos& pos = positions[i];
             const shape& sh = variations[pos.shape_idx][pos.var_idx];
             for (const auto& sq : sh.squares) {
-                int x = pos.x + sq.x - lt.x;
-                int y = pos.y + sq.y - lt.y;
-                mask[x + y*w] = 1;
+                board.set(pos.x + sq.x - lt.x, pos.y + sq.y - lt.y);
             }
         }
 
         // compute the starting point
         vec2i start{w/2, h/2};
-        if (mask[start.x + start.y*w]) {
+        if (board.is_set(start.x, start.y)) {
             for (const vec2i& offs : COFFS) {
                 vec2i c = start + offs;
-                if (mask[c.x + c.y*w] == 0) {
+                if (!board.is_set(c.x, c.y)) {
                     start = c;
                     break;
                 }
@@ -372,35 +481,93 @@ struct shape {
         }
 
         //  flood-fill
-        std::vector<vec2i> cellq;
-        vec2i c0 = start;
-        cellq.push_back(c0);
-        mask[c0.x + c0.y*w] = 1;
-        int nvisited = 0;
-        while (!cellq.empty()) {
-            vec2i c = cellq.back();
-            cellq.pop_back();
-            hit_fn(c.x + lt.x, c.y + lt.y);
-            nvisited++;
+        int nvisited = board.fill(start.x, start.y);
+        if (nvisited > 0) {
+            board.for_each_filled([&](int x, int y) { hit_fn(x + lt.x, y + lt.y); });
+        }
+        return nvisited;
+    }
+
+    //  gives the same result as flood_fill, but instead of visiting the enclosed cells
+    //  traces the contours of the shapes and measures the hole around the starting point
+    static int contour_area(const variation_array& variations, const_layout_ref positions) {
+        vec2i lt, rb;
+        get_bounds(variations, positions, lt, rb);
+
+        std::vector<rect_contour::point> cells;
+        for (const shape_pos& pos : positions) {
+            const shape& sh = variations[pos.shape_idx][pos.var_idx];
+            for (const auto& sq : sh.squares) {
+                cells.push_back({pos.x + sq.x - lt.x, pos.y + sq.y - lt.y});
+            }
+        }
+        return trace_area(cells, rb.x - lt.x + 1, rb.y - lt.y + 1, 
+            [&]() { return flood_fill(variations, positions, [](int, int){}); });
+    }
+
+    //  the contour_area's part past collecting the layout's cells (offset to the bounds' top-left corner
+    //  of w x h, in any order, possibly repeating), fill_fn() gives the flood_fill's result for the corner case
+    template <typename TFill>
+    static int trace_area(std::vector<rect_contour::point>& cells, int w, int h, TFill fill_fn) {
+        typedef rect_contour::point point;
+
+        std::sort(cells.begin(), cells.end());
+        cells.erase(std::unique(cells.begin(), cells.end()), cells.end());
+
+        auto is_set = [&](int x, int y) {
+            if (x < 0 || y < 0 || x >= w || y >= h) return true;
+            return std::binary_search(cells.begin(), cells.end(), point{x, y});
+        };
+
+        //  same starting point as in flood_fill
+        vec2i start{w/2, h/2};
+        if (is_set(start.x, start.y)) {
             for (const vec2i& offs : COFFS) {
-                vec2i c1 = c + offs;
-                if (c1.x < 0 || c1.y < 0 || 
-                    c1.x >= w || c1.y >= h) {
-                    return -1;
-                }
-                int idx = c1.x + c1.y*w;
-                if (mask[idx] == 0) {
-                    cellq.push_back(c1);
-                    mask[idx] = 1;
+                vec2i c = start + offs;
+                if (!is_set(c.x, c.y)) {
+                    start = c;
+                    break;
                 }
             }
         }
+        //  corner case of starting inside the shapes
+        if (is_set(start.x, start.y)) return fill_fn();
+
+        //  the shapes are 4-connected, and the free space is 8-connected
+        rect_contour contour;
+        contour.trace_cells(cells, {1, 1}, false);
+        const auto& chains = contour.chains;
+        const int nchains = (int)chains.size();
+        std::vector<int> areas(nchains);
+        for (int i = 0; i < nchains; i++) areas[i] = rect_contour::signed_area2(chains[i]);
+
+        //  finds the innermost chain around the cell, except the given one
+        auto innermost = [&](const point& c, int except) {
+            int res = -1;
+            for (int i = 0; i < nchains; i++) {
+                if (i == except || !rect_contour::contains(chains[i], c.x + 0.5, c.y + 0.5)) continue;
+                if (res < 0 || abs(areas[i]) < abs(areas[res])) res = i;
+            }
+            return res;
+        };
 
-        return nvisited;
+        int hole = innermost({start.x, start.y}, -1);
+        if (hole < 0 || areas[hole] > 0) return -1;
+
+        //  subtract the shapes which are inside of the hole
+        int area2 = -areas[hole];
+        for (int i = 0; i < nchains; i++) {
+            if (areas[i] < 0) continue;
+            //  the top-left corner of an outer contour is also a corner of its top-left cell
+            point corner = *std::min_element(chains[i].begin(), chains[i].end(), 
+                [](const point& a, const point& b) { return a.y == b.y ? a.x < b.x : a.y < b.y; });
+            if (innermost(corner, i) == hole) area2 -= areas[i];
+        }
+        return area2/2;
     }
 
     static bool extract_core(const variation_array& variations, 
-        const std::vector<shape_pos>& positions, shape& sh, vec2i& pos) 
+        const_layout_ref positions, shape& sh, vec2i& pos) 
     {
         pos.x = pos.y = std::numeric_limits<int>::max();
         int num_visited = flood_fill(variations, positions, [&](int x, int y) {
@@ -416,9 +583,36 @@ struct shape {
     }
 
 private:
+    typedef std::vector<uint64_t> row_masks;
+
+    //  max manhattan radius of the precomputed dilated row masks
+    static const int MAX_DILATION = 4;
+
     std::vector<char> mask;
     std::vector<vec2i> boundary;
 
+    //  rows[y] has the bit x set for every square (x, y),
+    //  empty if the shape is too wide to fit into a word together with the dilation
+    row_masks rows;
+
+    //  dilated[r - 1] is the shape grown by manhattan radius r, offset by (r, r)
+    std::vector<row_masks> dilated;
+
+    static inline uint64_t shifted(uint64_t bits, int dx) {
+        if (dx >= 64 || dx <= -64) return 0;
+        return dx >= 0 ? (bits << dx) : (bits >> -dx);
+    }
+
+    //  tests if rows1, offset by (dx, dy), have any common bits with rows2
+    static inline bool rows_intersect(const row_masks& rows1, int dx, int dy, const row_masks& rows2) {
+        const int y0 = std::max(0, -dy);
+        const int y1 = std::min((int)rows1.size(), (int)rows2.size() - dy);
+        for (int y = y0; y < y1; y++) {
+            if (shifted(rows1[y], dx) & rows2[y + dy]) return true;
+        }
+        return false;
+    }
+
     void setup() {
         //  compute extents
         const int n = (int)squares.size();
@@ -442,11 +636,32 @@ private:
             for (const auto& offs : OFFS) {
                 int x = sq.x + offs.x;
                 int y = sq.y + offs.y;
-                if (!is_set(x, y)) {
+                //  the cells next to several squares are only listed once
+                if (!is_set(x, y) && std::find(boundary.begin(), boundary.end(), vec2i(x, y)) == boundary.end()) {
                     boundary.push_back(vec2i(x, y));
                 }
             }
         }
+
+        //  compute the row masks and their dilations
+        rows.clear();
+        dilated.clear();
+        if (width + 2*MAX_DILATION > 64) return;
+        rows.resize(height, 0);
+        for (const auto& sq : squares) rows[sq.y] |= uint64_t(1) << sq.x;
+
+        const row_masks* prev = &rows;
+        for (int r = 1; r <= MAX_DILATION; r++) {
+            const int ph = (int)prev->size();
+            auto p = [&](int y) { return (y >= 0 && y < ph) ? (*prev)[y] : 0; };
+            row_masks d(ph + 2);
+            for (int y = 0; y < ph + 2; y++) {
+                uint64_t c = p(y - 1);
+                d[y] = c | (c << 1) | (c << 2) | (p(y) << 1) | (p(y - 2) << 1);
+            }
+            dilated.push_back(d);
+            prev = &dilated.back();
+        }
     }
 
 };
@@ -0,0 +1,218 @@
+#ifndef __SHAPE_LIBRARY__
+#define __SHAPE_LIBRARY__
+
+#include <vector>
+#include <cstdint>
+#include <limits>
+#include <algorithm>
+
+#include <vec2.hpp>
+#include <shape.hpp>
+#include <bitboard.hpp>
+#include <rect_contour.hpp>
+#include <fixed_shape.hpp>
+
+//  all the variants of a shape set packed together, indexed by the global variant id
+//  (the variants of the shape s get var_offset(s) + var_idx): a small descriptor per variant,
+//  and the squares, the boundary cells and the row masks of all of them in the shared arrays,
+//  with the 8-bit coordinates - so the whole thing takes a few kilobytes and stays in the cache.
+//  For the same-order sets (see dispatch_order) every variant has exactly order squares and order row masks
+//  (padded with the empty ones), so the loops over them can take the trip count at compile time.
+//  It's built once and is read-only after that, so it can be shared between the threads.
+//  The layout functions give exactly the same results as the shape:: ones do.
+class shape_library {
+public:
+    typedef uint64_t word;
+
+    struct cell {
+        int8_t x, y;
+        vec2i p() const { return {x, y}; }
+    };
+
+    struct cell_range {
+        const cell* first;
+        const cell* last;
+        const cell* begin() const { return first; }
+        const cell* end() const { return last; }
+        int size() const { return (int)(last - first); }
+    };
+
+    struct variant {
+        uint8_t width, height;
+        uint16_t num_squares;
+        uint16_t num_boundary;
+        uint16_t shape_idx;
+        uint32_t squares;       //  the offsets into cells
+        uint32_t boundary;
+        uint32_t rows;          //  the offset into row_bits, the masks are empty if the variant is wider than a word,
+                                //  there are num_rows<N>() of them
+    };
+
+    explicit shape_library(const shape::variation_array& _variations) : variations(_variations), max_ext(0) {
+        order = dispatch_order(shape::order(variations), [](auto n) { return decltype(n)::value; });
+        for (size_t s = 0; s < variations.size(); s++) {
+            var_offset.push_back((int)variants.size());
+            for (const shape& sh : variations[s]) {
+                assert(sh.width < 128 && sh.height < 128);
+                variant v;
+                v.width = (uint8_t)sh.width;
+                v.height = (uint8_t)sh.height;
+                v.shape_idx = (uint16_t)s;
+                v.num_squares = (uint16_t)sh.squares.size();
+                v.squares = (uint32_t)cells.size();
+                for (const vec2i& sq : sh.squares) cells.push_back({(int8_t)sq.x, (int8_t)sq.y});
+                v.num_boundary = (uint16_t)sh.get_boundary().size();
+                v.boundary = (uint32_t)cells.size();
+                for (const vec2i& b : sh.get_boundary()) cells.push_back({(int8_t)b.x, (int8_t)b.y});
+                v.rows = (uint32_t)row_bits.size();
+                assert(order == 0 || sh.height <= order);
+                const int nrows = (order == 0) ? sh.height : order;
+                for (int r = 0; r < nrows; r++) {
+                    word bits = 0;
+                    for (int c = 0; c < sh.width && c < bitboard::WORD_BITS; c++) {
+                        if (sh.is_set(c, r)) bits |= word(1) << c;
+                    }
+                    row_bits.push_back(bits);
+                }
+                variants.push_back(v);
+                max_ext = std::max(max_ext, std::max(sh.width, sh.height));
+            }
+        }
+        var_offset.push_back((int)variants.size());
+    }
+
+    shape_library(const shape_library&) = delete;
+    shape_library& operator =(const shape_library&) = delete;
+
+    //  the nested form, for the code off the hot path
+    const shape::variation_array& get_variations() const { return variations; }
+
+    int num_shapes() const { return (int)var_offset.size() - 1; }
+    int num_vars() const { return (int)variants.size(); }
+    int num_variants(int shape_idx) const { return var_offset[shape_idx + 1] - var_offset[shape_idx]; }
+    int get_var_offset(int shape_idx) const { return var_offset[shape_idx]; }
+    int var_id(const shape_pos& pos) const { return var_offset[pos.shape_idx] + pos.var_idx; }
+
+    //  the biggest width or height over all the variants
+    int max_extent() const { return max_ext; }
+
+    //  the shapes' order if it's specialized (see dispatch_order), 0 otherwise
+    int get_order() const { return order; }
+
+    //  the squares and the row masks per variant, as compile-time constants when N is the specialized order
+    template <int N> int num_squares(const variant& v) const { return N > 0 ? N : v.num_squares; }
+    template <int N> int num_rows(const variant& v) const { return N > 0 ? N : v.height; }
+
+    const variant& get(int vid) const { return variants[vid]; }
+    const variant& get(const shape_pos& pos) const { return variants[var_id(pos)]; }
+
+    cell_range squares(const variant& v) const { return {&cells[v.squares], &cells[v.squares] + v.num_squares}; }
+    cell_range boundary(const variant& v) const { return {&cells[v.boundary], &cells[v.boundary] + v.num_boundary}; }
+    const word* rows(const variant& v) const { return &row_bits[v.rows]; }
+
+    size_t memory_size() const {
+        return variants.size()*sizeof(variant) + cells.size()*sizeof(cell) + row_bits.size()*sizeof(word) +
+            var_offset.size()*sizeof(int);
+    }
+
+    //  same as shape::get_bounds
+    void get_bounds(const_layout_ref positions, vec2i& lt, vec2i& rb) const {
+        lt = {std::numeric_limits<int>::max(), std::numeric_limits<int>::max()};
+        rb = {std::numeric_limits<int>::min(), std::numeric_limits<int>::min()};
+        const int n = num_shapes();
+        for (int i = 0; i < n; i++) {
+            const shape_pos& pos = positions[i];
+            const variant& v = get(pos);
+            lt.x = std::min(lt.x, (int)pos.x);
+            lt.y = std::min(lt.y, (int)pos.y);
+            rb.x = std::max(rb.x, pos.x + v.width);
+            rb.y = std::max(rb.y, pos.y + v.height);
+        }
+    }
+
+    //  same as shape::center
+    void center(layout_ref positions) const {
+        vec2i lt, rb;
+        get_bounds(positions, lt, rb);
+        const int cx = (rb.x + lt.x)/2;
+        const int cy = (rb.y + lt.y)/2;
+        for (auto& pos : positions) {
+            pos.x -= cx;
+            pos.y -= cy;
+        }
+    }
+
+    //  same as shape::flood_fill, without visiting the cells
+    int flood_fill(const_layout_ref positions, bitboard& board) const {
+        vec2i lt, rb;
+        get_bounds(positions, lt, rb);
+        const int w = rb.x - lt.x + 1;
+        const int h = rb.y - lt.y + 1;
+
+        board.reset(w, h);
+        dispatch_order(order, [&](auto n) { rasterize<decltype(n)::value>(positions, lt, board); });
+
+        vec2i start{w/2, h/2};
+        if (board.is_set(start.x, start.y)) {
+            for (const vec2i& offs : COFFS) {
+                vec2i c = start + offs;
+                if (!board.is_set(c.x, c.y)) {
+                    start = c;
+                    break;
+                }
+            }
+        }
+        return board.fill(start.x, start.y);
+    }
+
+    //  same as shape::contour_area
+    int contour_area(const_layout_ref positions) const {
+        vec2i lt, rb;
+        get_bounds(positions, lt, rb);
+        std::vector<rect_contour::point> pts;
+        for (const shape_pos& pos : positions) {
+            for (const cell& sq : squares(get(pos))) pts.push_back({pos.x + sq.x - lt.x, pos.y + sq.y - lt.y});
+        }
+        return shape::trace_area(pts, rb.x - lt.x + 1, rb.y - lt.y + 1, [&]() {
+            bitboard board;
+            return flood_fill(positions, board);
+        });
+    }
+
+    //  same as shape::score
+    template <typename TDistFn>
+    double score(const_layout_ref positions, const TDistFn& dist_fn, bitboard& board,
+        area_method method = area_method::FloodFill) const
+    {
+        const int area = (method == area_method::Contour) ? contour_area(positions) : flood_fill(positions, board);
+        if (area > 0) return area;
+        double dist = 0.0;
+        const int n = num_shapes();
+        for (int i = 0; i < n; i++) dist += abs(dist_fn(positions[i], positions[(i + 1)%n]));
+        return -dist;
+    }
+
+    //  sets the squares of all the shapes on the board, with lt at its origin
+    template <int N>
+    void rasterize(const_layout_ref positions, const vec2i& lt, bitboard& board) const {
+        const int n = num_shapes();
+        for (int i = 0; i < n; i++) {
+            const shape_pos& pos = positions[i];
+            const variant& v = get(pos);
+            const cell* sq = &cells[v.squares];
+            for (int j = 0; j < num_squares<N>(v); j++) board.set(pos.x + sq[j].x - lt.x, pos.y + sq[j].y - lt.y);
+        }
+    }
+
+private:
+    const shape::variation_array& variations;
+    int max_ext;
+    int order;
+
+    std::vector<int> var_offset;    //  num_shapes + 1 of them
+    std::vector<variant> variants;
+    std::vector<cell> cells;
+    std::vector<word> row_bits;
+};
+
+#endif // __SHAPE_LIBRARY__
@@ -0,0 +1,32 @@
+#ifndef __SOLVER__
+#define __SOLVER__
+
+#include <vector>
+#include <cstddef>
+
+#include <shape.hpp>
+
+//  a search engine, advanced one iteration at a time by the caller,
+//  which measures the time and reports the progress
+class solver {
+public:
+    virtual ~solver() {}
+
+    virtual const char* name() const = 0;
+
+    //  prepares the starting state, before the first step
+    virtual void init() = 0;
+
+    //  a single iteration of the search
+    virtual void step(int it) = 0;
+
+    virtual double best_score() const = 0;
+
+    //  the layouts to show, from the best one
+    virtual void get_ranked(std::vector<const_layout_ref>& res) const = 0;
+
+    //  the number of the layouts scored so far
+    virtual size_t num_evals() const = 0;
+};
+
+#endif // __SOLVER__
@@ -30,9 +30,45 @@ void gen_shape_path(const shape& sh, std::ostream& os, int ext = 1, int cell_sid
     }
 }
 
+svg_path_cache::svg_path_cache(const shape::variation_array& _variations) : variations(_variations) {
+    int nvars = 0;
+    for (const auto& vars : variations) {
+        var_offset.push_back(nvars);
+        nvars += (int)vars.size();
+    }
+    var_offset.push_back(nvars);
+}
+
+const std::string& svg_path_cache::get(int shape_idx, int var_idx, int cell_side, int ext) {
+    //  there are only a couple of the (cell_side, ext) pairs in use
+    entry* e = nullptr;
+    for (auto& it : entries) {
+        if (it.cell_side == cell_side && it.ext == ext) e = &it;
+    }
+    if (!e) {
+        entries.push_back({cell_side, ext, std::vector<std::string>(var_offset.back())});
+        e = &entries.back();
+    }
+    std::string& res = e->paths[var_offset[shape_idx] + var_idx];
+    if (res.empty()) {
+        std::stringstream ss;
+        gen_shape_path(variations[shape_idx][var_idx], ss, ext, cell_side);
+        res = ss.str();
+    }
+    return res;
+}
+
 void create_svg(std::ostream& os, const shape::variation_array& variations, 
-        const std::vector<shape_pos>& positions, const shape* core, const vec2i* core_pos, int cell_side) 
+        const_layout_ref positions, const shape* core, const vec2i* core_pos, int cell_side) 
+{
+    svg_path_cache paths(variations);
+    create_svg(os, paths, positions, core, core_pos, cell_side);
+}
+
+void create_svg(std::ostream& os, svg_path_cache& paths, 
+        const_layout_ref positions, const shape* core, const vec2i* core_pos, int cell_side) 
 {
+    const shape::variation_array& variations = paths.get_variations();
     vec2i lt, rb;
     shape::get_bounds(variations, positions, lt, rb);
     
@@ -77,15 +113,13 @@ void create_svg(std::ostream& os, const shape::variation_array& variations,
     const size_t nshapes = variations.size();
     for (size_t i = 0; i < nshapes; i++) {
         const shape_pos& pos = positions[i];
-        const shape& sh = variations[pos.shape_idx][pos.var_idx];
 
         float x = (float)(pos.x - lt.x);
         float y = (float)(pos.y - lt.y);
 
         float dx = x*cell_side;
         float dy = y*cell_side;
-        os << "\n  <path d=\""; 
-        gen_shape_path(sh, os, 1, cell_side);
+        os << "\n  <path d=\"" << paths.get(pos.shape_idx, pos.var_idx, cell_side, 1);
         const char* color = COLORS[pos.shape_idx%COLORS.size()];
         os << "\" fill=\"#" << color << "\" class=\"shape\" " << 
             "transform=\"translate(" << dx << "," << dy << ")\"" << ">" << "</path>";
@@ -2,11 +2,37 @@
 #define __SVG_GEN_H__
 
 #include <vector>
+#include <string>
 
 #include <vec2.hpp>
 #include <shape.hpp>
 
-void create_svg(std::ostream& os, const shape::variation_array& variations, const std::vector<shape_pos>& positions, 
+//  the svg paths of the variants' outlines, each traced once per cell side and extrusion and kept
+//  for the later layouts. Not thread-safe, each rendering thread needs its own.
+class svg_path_cache {
+public:
+    explicit svg_path_cache(const shape::variation_array& variations);
+
+    const std::string& get(int shape_idx, int var_idx, int cell_side, int ext);
+
+    const shape::variation_array& get_variations() const { return variations; }
+
+private:
+    struct entry {
+        int cell_side, ext;
+        std::vector<std::string> paths;     //  per variant, empty until it's needed
+    };
+
+    const shape::variation_array& variations;
+    std::vector<int> var_offset;
+    std::vector<entry> entries;
+};
+
+void create_svg(std::ostream& os, const shape::variation_array& variations, const_layout_ref positions, 
+    const shape* core = nullptr, const vec2i* core_pos = nullptr, int cell_side = 15);
+
+//  same, taking the pieces' paths from the cache
+void create_svg(std::ostream& os, svg_path_cache& paths, const_layout_ref positions, 
     const shape* core = nullptr, const vec2i* core_pos = nullptr, int cell_side = 15);
 
 
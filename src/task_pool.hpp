@@ -0,0 +1,151 @@
+#ifndef __TASK_POOL__
+#define __TASK_POOL__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <memory>
+#include <algorithm>
+#include <type_traits>
+
+//  a fixed set of worker threads running parallel loops over index ranges:
+//  every worker starts with its own contiguous slice of the range and takes
+//  the items from its front, and once it runs dry, it steals the back half
+//  of some other worker's remaining slice. The calling thread works as worker 0.
+class task_pool {
+public:
+    //  0 means one worker per hardware thread
+    explicit task_pool(int num_threads = 0) {
+        if (num_threads <= 0) num_threads = (int)std::thread::hardware_concurrency();
+        num_workers = std::max(1, num_threads);
+        ranges.reset(new worker_range[num_workers]);
+        for (int i = 1; i < num_workers; i++) threads.emplace_back([this, i]() { worker_loop(i); });
+    }
+
+    ~task_pool() {
+        {
+            std::lock_guard<std::mutex> lock(job_lock);
+            stopping = true;
+        }
+        job_cv.notify_all();
+        for (auto& t : threads) t.join();
+    }
+
+    task_pool(const task_pool&) = delete;
+    task_pool& operator =(const task_pool&) = delete;
+
+    int size() const { return num_workers; }
+
+    //  calls fn(i, worker) for every i in [0, n), where worker is in [0, size()),
+    //  and returns when all of them are done. The items are taken by "grain" at a time.
+    template <typename TFn>
+    void parallel_for(int n, TFn&& fn, int grain = 1) {
+        if (n <= 0) return;
+        typedef typename std::remove_reference<TFn>::type fn_type;
+
+        //  split the range evenly, the stealing takes care of the imbalance
+        for (int i = 0; i < num_workers; i++) {
+            std::lock_guard<std::mutex> lock(ranges[i].lock);
+            ranges[i].begin = (int)((long long)n*i/num_workers);
+            ranges[i].end = (int)((long long)n*(i + 1)/num_workers);
+        }
+
+        {
+            std::lock_guard<std::mutex> lock(job_lock);
+            job_ctx = (void*)&fn;
+            job_call = [](void* ctx, int i, int worker) { (*(fn_type*)ctx)(i, worker); };
+            job_grain = std::max(1, grain);
+            num_active = num_workers - 1;
+            job_id++;
+        }
+        job_cv.notify_all();
+
+        run_job(0);
+
+        std::unique_lock<std::mutex> lock(job_lock);
+        done_cv.wait(lock, [this]() { return num_active == 0; });
+    }
+
+private:
+    struct worker_range {
+        std::mutex lock;
+        int begin = 0, end = 0;
+    };
+
+    int num_workers;
+    std::unique_ptr<worker_range[]> ranges;
+    std::vector<std::thread> threads;
+
+    std::mutex job_lock;
+    std::condition_variable job_cv, done_cv;
+    unsigned long long job_id = 0;
+    int num_active = 0;
+    bool stopping = false;
+
+    void* job_ctx = nullptr;
+    void (*job_call)(void*, int, int) = nullptr;
+    int job_grain = 1;
+
+    void worker_loop(int worker) {
+        unsigned long long last_job = 0;
+        while (true) {
+            {
+                std::unique_lock<std::mutex> lock(job_lock);
+                job_cv.wait(lock, [&]() { return stopping || job_id != last_job; });
+                if (stopping) return;
+                last_job = job_id;
+            }
+
+            run_job(worker);
+
+            {
+                std::lock_guard<std::mutex> lock(job_lock);
+                num_active--;
+            }
+            done_cv.notify_one();
+        }
+    }
+
+    void run_job(int worker) {
+        int begin, end;
+        while (pop(worker, begin, end) || (steal(worker) && pop(worker, begin, end))) {
+            for (int i = begin; i < end; i++) job_call(job_ctx, i, worker);
+        }
+    }
+
+    //  takes the next chunk from the front of the worker's own slice
+    bool pop(int worker, int& begin, int& end) {
+        worker_range& r = ranges[worker];
+        std::lock_guard<std::mutex> lock(r.lock);
+        if (r.begin >= r.end) return false;
+        begin = r.begin;
+        end = std::min(r.end, r.begin + job_grain);
+        r.begin = end;
+        return true;
+    }
+
+    //  moves the back half of some other worker's slice into the worker's own one
+    bool steal(int worker) {
+        for (int k = 1; k < num_workers; k++) {
+            worker_range& victim = ranges[(worker + k)%num_workers];
+            int begin, end;
+            {
+                std::lock_guard<std::mutex> lock(victim.lock);
+                const int left = victim.end - victim.begin;
+                if (left <= 0) continue;
+                begin = victim.end - (left + 1)/2;
+                end = victim.end;
+                victim.end = begin;
+            }
+            worker_range& r = ranges[worker];
+            std::lock_guard<std::mutex> lock(r.lock);
+            r.begin = begin;
+            r.end = end;
+            return true;
+        }
+        return false;
+    }
+};
+
+#endif // __TASK_POOL__
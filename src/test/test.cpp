@@ -1,7 +1,31 @@
 #include "CppUnitTest.h"
 #include <iostream>
+#include <fstream>
+#include <random>
 
 #include <shape.hpp>
+#include <pair_table.hpp>
+#include <shape_library.hpp>
+#include <fixed_shape.hpp>
+#include <layout_eval.hpp>
+#include <circle_seeder.hpp>
+#include <batch_score.hpp>
+#include <task_pool.hpp>
+#include <philox.hpp>
+#include <islands.hpp>
+#include <mutation.hpp>
+#include <op_scheduler.hpp>
+#include <selection.hpp>
+#include <layout_arena.hpp>
+#include <layout_hash.hpp>
+#include <score_cache.hpp>
+#include <local_search.hpp>
+#include <ga_solver.hpp>
+#include <branch_bound.hpp>
+#include <run_control.hpp>
+#include <svg_gen.h>
+#include <checkpoint.h>
+#include <result_writer.h>
 
 
 using namespace Microsoft::VisualStudio::CppUnitTestFramework;
@@ -45,6 +69,14 @@ static const char* SHAPE3 =
     "   O\n"
     ;
 
+static const char* SHAPE4 = 
+    "OOOO\n"
+    ;
+
+static const char* SHAPE5 = 
+    "O\n"
+    ;
+
 
 TEST_CLASS(test_shape)
 {
@@ -132,6 +164,362 @@ public:
             distance(shape2, {0, -4}, shape3, {1, 1}));
     }
 
+    TEST_METHOD(test_distance_row_masks) {
+        //  compare against the plain pairwise manhattan distance between the squares
+        std::vector<shape> vars2 = shape2.get_variations();
+        std::vector<shape> vars3 = shape3.get_variations();
+        for (const shape& sh2 : vars2) {
+            for (const shape& sh3 : vars3) {
+                for (int y = -12; y <= 12; y++) {
+                    for (int x = -12; x <= 12; x++) {
+                        int d = std::numeric_limits<int>::max();
+                        for (const auto& sq2 : sh2.squares) {
+                            for (const auto& sq3 : sh3.squares) {
+                                d = std::min(d, abs(x + sq2.x - sq3.x) + abs(y + sq2.y - sq3.y));
+                            }
+                        }
+                        Assert::AreEqual(d - 1, distance(sh2, {x, y}, sh3, {0, 0}));
+                        overlap ov = d == 0 ? overlap::Overlap : (d == 1 ? overlap::Border : overlap::Disjoint);
+                        Assert::AreEqual(ov, overlap_status(sh2, {x, y}, sh3, {0, 0}));
+                    }
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(test_pair_table) {
+        shape::variation_array variations = {shape2.get_variations(), shape3.get_variations()};
+        pair_table table(variations, 6);
+
+        Assert::AreEqual(-1, table({0, 0, 0, 0}, {0, 0, 1, 0}));
+        Assert::AreEqual(0, table({0, -3, 0, 0}, {0, 0, 1, 0}));
+        Assert::AreEqual(1, table({0, -4, 0, 0}, {0, 0, 1, 0}));
+        Assert::AreEqual(2, table({0, -4, 0, 0}, {1, 1, 1, 0}));
+        Assert::AreEqual(overlap::Border, table.overlap_status({0, -3, 0, 0}, {0, 0, 1, 0}));
+
+        //  outside of the window
+        Assert::AreEqual(distance(shape2, {0, -20}, shape3, {1, 1}), table({0, -20, 0, 0}, {1, 1, 1, 0}));
+
+        for (int y = -8; y <= 8; y++) {
+            for (int x = -8; x <= 8; x++) {
+                for (int v = 0; v < (int)variations[1].size(); v++) {
+                    Assert::AreEqual(distance(variations[1][v], {x, y}, shape2, {0, 0}), 
+                        table(shape_pos::at({x, y}, 1, v), {0, 0, 0, 0}));
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(test_pair_table_wide_window) {
+        //  the wide windows get capped, so that the far corners' distances still fit
+        shape::variation_array variations = {shape2.get_variations(), shape3.get_variations()};
+        pair_table table(variations, 100);
+        const int w = table.get_window();
+        Assert::IsTrue(w < 100);
+        for (int y : {-w, -w/2, 0, w}) {
+            for (int x : {-w, -w + 1, w/2, w, w + 1}) {
+                for (int v = 0; v < (int)variations[1].size(); v++) {
+                    Assert::AreEqual(distance(variations[1][v], {x, y}, shape2, {0, 0}), 
+                        table(shape_pos::at({x, y}, 1, v), {0, 0, 0, 0}));
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(test_fixed_distance) {
+        shape::variation_array variations = {shape1.get_variations(), shape2.get_variations(), shape3.get_variations()};
+        Assert::AreEqual(5, shape::order(variations));
+
+        shape sh4;
+        shape::parse(std::stringstream(SHAPE4), sh4);
+        shape::variation_array mixed = {shape1.get_variations(), sh4.get_variations()};
+        Assert::AreEqual(0, shape::order(mixed));
+        Assert::AreEqual(0, pair_table(mixed, 2).get_order());
+
+        Assert::AreEqual(5, dispatch_order(5, [](auto n) { return decltype(n)::value; }));
+        Assert::AreEqual(0, dispatch_order(7, [](auto n) { return decltype(n)::value; }));
+
+        pair_table table(variations, 2);
+        Assert::AreEqual(5, table.get_order());
+        for (uint16_t s1 = 0; s1 < 3; s1++) {
+            for (uint16_t s2 = 0; s2 < 3; s2++) {
+                for (int y = -10; y <= 10; y++) {
+                    for (int x = -10; x <= 10; x++) {
+                        shape_pos pos1 = shape_pos::at({x, y}, s1, (int)((x + 10)%variations[s1].size()));
+                        shape_pos pos2 = {0, 0, s2, (uint16_t)((y + 10)%variations[s2].size())};
+                        const shape& sh1 = variations[s1][pos1.var_idx];
+                        const shape& sh2 = variations[s2][pos2.var_idx];
+                        const int dist = distance(sh1, pos1.p(), sh2, pos2.p());
+                        Assert::AreEqual(dist, fixed_distance<5>(sh1.squares.data(), pos1.p() - pos2.p(), 
+                            sh2.squares.data()));
+                        Assert::AreEqual(dist, table(pos1, pos2));
+                    }
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(test_flood_fill) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(4, sh.get_variations());
+
+        //  four sticks around a 3x3 hole
+        std::vector<shape_pos> positions = {{0, 0, 0, 0}, {4, 0, 1, 1}, {1, 4, 2, 0}, {0, 1, 3, 1}};
+        std::vector<vec2i> cells;
+        int area = shape::flood_fill(variations, positions, [&](int x, int y) { cells.push_back({x, y}); });
+        Assert::AreEqual(9, area);
+        Assert::AreEqual(9.0, shape::score(variations, positions));
+        std::sort(cells.begin(), cells.end(), [](const vec2i& a, const vec2i& b) { 
+            return a.y == b.y ? a.x < b.x : a.y < b.y; 
+        });
+        std::vector<vec2i> hole = {{1, 1}, {2, 1}, {3, 1}, {1, 2}, {2, 2}, {3, 2}, {1, 3}, {2, 3}, {3, 3}};
+        Assert::AreEqual(hole, cells);
+
+        //  shift the right stick away, so the hole leaks out
+        positions[1].x = 5;
+        Assert::AreEqual(-1, shape::flood_fill(variations, positions, [](int, int) {}));
+        Assert::AreEqual(-2.0, shape::score(variations, positions));
+    }
+
+    TEST_METHOD(test_layout_eval) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(4, sh.get_variations());
+        shape_library lib(variations);
+
+        std::vector<shape_pos> parent = {{0, 0, 0, 0}, {4, 0, 1, 1}, {1, 4, 2, 0}, {0, 1, 3, 1}};
+        layout_eval eval(lib);
+        eval.set_parent(parent);
+
+        std::vector<shape_pos> target = parent;
+        std::vector<int> changed = {1};
+        target[1].x = 5;
+        Assert::AreEqual(shape::score(variations, target), eval.score(target, changed));
+
+        //  the parent's state must be restored after scoring
+        Assert::AreEqual(9.0, eval.score(parent, changed));
+
+        //  moving far away falls back to the full scoring
+        target[1].x = 20;
+        Assert::AreEqual(shape::score(variations, target), eval.score(target, changed));
+
+        target = parent;
+        changed = {0, 1, 2, 0};
+        std::swap(target[0].shape_idx, target[2].shape_idx);
+        target[1].var_idx = 0;
+        Assert::AreEqual(shape::score(variations, target), eval.score(target, changed));
+    }
+
+    TEST_METHOD(test_batch_score) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(4, sh.get_variations());
+        shape_library lib(variations);
+
+        std::vector<shape_pos> positions = {{0, 0, 0, 0}, {4, 0, 1, 1}, {1, 4, 2, 0}, {0, 1, 3, 1}};
+        std::vector<std::vector<shape_pos>> candidates;
+        candidates.push_back(positions);
+        for (int k = 1; k < 7; k++) {
+            candidates.push_back(positions);
+            candidates.back()[k%4].x += k/2;
+            candidates.back()[(k + 1)%4].var_idx = k%2;
+        }
+        //  doesn't fit into a single row word
+        candidates.back()[2].x += 70;
+
+        layout_block block;
+        block.resize(4, 8);
+        for (int k = 0; k < 7; k++) block.set(k, candidates[k]);
+
+        batch_scorer batch(lib);
+        double scores[8];
+        batch.score(block, 7, scores);
+        for (int k = 0; k < 7; k++) {
+            Assert::AreEqual(shape::score(variations, candidates[k]), scores[k]);
+        }
+        Assert::AreEqual(9.0, scores[0]);
+
+        std::vector<shape_pos> res;
+        block.get(3, res);
+        Assert::IsTrue(res == candidates[3]);
+    }
+
+    TEST_METHOD(test_fixed_order_paths) {
+        shape sh4;
+        shape::parse(std::stringstream(SHAPE4), sh4);
+        shape::variation_array same = {shape1.get_variations(), shape2.get_variations(), 
+            shape3.get_variations(), shape3.get_variations()};
+        shape::variation_array mixed = {shape1.get_variations(), sh4.get_variations(), 
+            shape3.get_variations(), shape2.get_variations()};
+
+        //  the specialized order and the generic path give the same results as shape::score
+        for (const auto* variations : {&same, &mixed}) {
+            shape_library lib(*variations);
+            Assert::AreEqual(variations == &same ? 5 : 0, lib.get_order());
+
+            //  half of them enclose something, half of them don't
+            std::mt19937 rng(4321);
+            std::vector<std::vector<shape_pos>> candidates;
+            std::vector<double> expected;
+            int num_closed = 0;
+            while (candidates.size() < 16) {
+                std::vector<shape_pos> c;
+                for (uint16_t s = 0; s < 4; s++) {
+                    const int var = (int)(rng()%(*variations)[s].size());
+                    c.push_back(shape_pos::at({(int)(rng()%5), (int)(rng()%5)}, s, var));
+                }
+                const double score = shape::score(*variations, c);
+                if ((score > 0) != (num_closed < 8)) continue;
+                num_closed += (score > 0) ? 1 : 0;
+                candidates.push_back(c);
+                expected.push_back(score);
+            }
+
+            layout_block block;
+            block.resize(4, 16);
+            for (int k = 0; k < 16; k++) block.set(k, candidates[k]);
+            batch_scorer batch(lib);
+            double scores[16];
+            batch.score(block, 16, scores);
+
+            layout_eval eval(lib);
+            eval.set_parent(candidates[0]);
+            std::vector<int> changed;
+            bitboard board;
+            for (int k = 0; k < 16; k++) {
+                Assert::AreEqual(expected[k], scores[k]);
+                Assert::AreEqual(shape::flood_fill(*variations, candidates[k], [](int, int){}, board), 
+                    lib.flood_fill(candidates[k], board));
+
+                changed.clear();
+                for (int i = 0; i < 4; i++) {
+                    if (!(candidates[k][i] == candidates[0][i])) changed.push_back(i);
+                }
+                Assert::AreEqual(expected[k], eval.score(candidates[k], changed));
+            }
+        }
+    }
+
+    TEST_METHOD(test_trace_bitmap) {
+        //  a ring: the outer contour and the hole, going the opposite ways
+        std::vector<bool> ring = {
+            1, 1, 1, 
+            1, 0, 1, 
+            1, 1, 1};
+        rect_contour c1;
+        c1.trace_bitmap(ring, 3);
+        Assert::AreEqual(2, (int)c1.chains.size());
+        Assert::AreEqual(4, (int)c1.chains[0].size());
+        Assert::AreEqual(18, rect_contour::signed_area2(c1.chains[0]));
+        Assert::AreEqual(-2, rect_contour::signed_area2(c1.chains[1]));
+        Assert::IsTrue(c1.svg_path() == "M0 0 3 0 3 3 0 3 z M1 1 1 2 2 2 2 1 z ");
+
+        //  the pixels touching by a corner, joined or not
+        std::vector<bool> diag = {
+            1, 0, 
+            0, 1};
+        rect_contour c2, c3;
+        c2.trace_bitmap(diag, 2, {10, 10}, true);
+        c3.trace_bitmap(diag, 2, {10, 10}, false);
+        Assert::AreEqual(1, (int)c2.chains.size());
+        Assert::AreEqual(8, (int)c2.chains[0].size());
+        Assert::AreEqual(2, (int)c3.chains.size());
+        Assert::AreEqual(400, rect_contour::signed_area2(c2.chains[0]));
+
+        //  the list of the cells gives the same, wherever they are
+        rect_contour c4;
+        c4.trace_cells({{5, -3}, {6, -2}}, {10, 10}, true);
+        Assert::AreEqual(1, (int)c4.chains.size());
+        for (size_t i = 0; i < c2.chains[0].size(); i++) {
+            Assert::AreEqual(c2.chains[0][i].x + 50, c4.chains[0][i].x);
+            Assert::AreEqual(c2.chains[0][i].y - 30, c4.chains[0][i].y);
+        }
+    }
+
+    TEST_METHOD(test_contour_area) {
+        shape sh, dot;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::parse(std::stringstream(SHAPE5), dot);
+        shape::variation_array variations(4, sh.get_variations());
+        variations.push_back(dot.get_variations());
+
+        //  a single square inside of the 3x3 hole
+        std::vector<shape_pos> positions = {{0, 0, 0, 0}, {4, 0, 1, 1}, {1, 4, 2, 0}, {0, 1, 3, 1}, {2, 2, 4, 0}};
+        Assert::AreEqual(8, shape::contour_area(variations, positions));
+        positions[4].x = 1;
+        Assert::AreEqual(8, shape::contour_area(variations, positions));
+
+        //  leaking through the diagonal gap
+        positions[1].x = 5;
+        positions[1].y = 1;
+        Assert::AreEqual(-1, shape::contour_area(variations, positions));
+
+        //  compare against the flood fill on the actual shape sets
+        std::string dir(__FILE__);
+        dir = dir.substr(0, dir.find_last_of("/\\") + 1) + "../../data/";
+        for (const char* name : {"tetrominoes.txt", "pentominoes.txt", "hexominoes.txt"}) {
+            std::ifstream ifs(dir + name);
+            std::vector<shape> shapes = shape::parse(ifs);
+            Assert::IsFalse(shapes.empty());
+
+            shape::variation_array variations;
+            for (const auto& sh : shapes) variations.push_back(sh.get_variations());
+            const int n = (int)shapes.size();
+
+            std::mt19937 rng(12345);
+            int nclosed = 0;
+            for (int box = 4; box <= 24; box += 4) {
+                for (int k = 0; k < 500; k++) {
+                    std::vector<shape_pos> pos(n);
+                    for (int i = 0; i < n; i++) {
+                        pos[i] = shape_pos::at({(int)(rng()%box), (int)(rng()%box)}, i, 
+                            (int)(rng()%variations[i].size()));
+                    }
+                    int area = shape::flood_fill(variations, pos, [](int, int) {});
+                    Assert::AreEqual(area, shape::contour_area(variations, pos));
+                    if (area > 0) nclosed++;
+                }
+            }
+            Assert::IsTrue(nclosed > 0);
+        }
+    }
+
+    TEST_METHOD(test_bitboard_avx2) {
+        //  the AVX2 sweep (where the CPU has it) fills the same cells as the plain one
+        bitboard simd, plain;
+        plain.set_avx2(false);
+        Assert::IsFalse(plain.uses_avx2());
+        Assert::AreEqual(bitboard::has_avx2(), simd.uses_avx2());
+        int enclosed = 0;
+        for (uint32_t k = 0; k < 300; k++) {
+            philox_rng rng(17, k, 0, 0);
+            const int w = 3 + (int)rng.below(62), h = 3 + (int)rng.below(40);
+            const uint32_t density = 20 + rng.below(40);
+            simd.reset(w, h);
+            plain.reset(w, h);
+            for (int y = 0; y < h; y++) {
+                for (int x = 0; x < w; x++) {
+                    //  a closed frame, so that not every fill leaks out
+                    const bool frame = (k%2) && (x == 0 || y == 0 || x == w - 1 || y == h - 1);
+                    if (frame || rng.below(100) < density) {
+                        simd.set(x, y);
+                        plain.set(x, y);
+                    }
+                }
+            }
+            const int area = plain.fill(w/2, h/2);
+            Assert::AreEqual(area, simd.fill(w/2, h/2));
+            if (area < 0) continue;     //  where it stopped when leaking out doesn't matter
+            std::vector<vec2i> cells1, cells2;
+            plain.for_each_filled([&](int x, int y) { cells1.push_back({x, y}); });
+            simd.for_each_filled([&](int x, int y) { cells2.push_back({x, y}); });
+            Assert::IsTrue(cells1 == cells2);
+            enclosed++;
+        }
+        Assert::IsTrue(enclosed > 30);
+    }
+
     TEST_METHOD(test_angle_greater) {
         Assert::IsTrue(angle_greater(1.0, 0.0));
         Assert::IsFalse(angle_greater(0.0, 0.0));
@@ -142,6 +530,1055 @@ public:
         Assert::IsFalse(angle_greater(6.0, 1.0));
     }
 
+    TEST_METHOD(test_circle_seeder) {
+        std::string dir(__FILE__);
+        dir = dir.substr(0, dir.find_last_of("/\\") + 1) + "../../data/";
+        for (const char* name : {"tetrominoes.txt", "pentominoes.txt", "hexominoes.txt"}) {
+            std::ifstream ifs(dir + name);
+            std::vector<shape> shapes = shape::parse(ifs);
+            shape::variation_array variations;
+            for (const auto& sh : shapes) variations.push_back(sh.get_variations());
+            const int n = (int)shapes.size();
+            pair_table table(variations, 4);
+            shape_library lib(variations);
+
+            double len = 0.0;
+            for (const shape& sh : shapes) len += sh.estimate_len();
+
+            //  the same layouts as the plain version, also with the radii too small or too big to close the ring
+            std::mt19937 rng(777);
+            for (double scale : {0.3, 1.0, 2.5}) {
+                const double radius = scale*len/(2.0*PI);
+                circle_seeder seeder(lib, radius, table);
+                for (int k = 0; k < 20; k++) {
+                    std::vector<shape_pos> pos1(n, {0, 0, 0, 0});
+                    for (int i = 0; i < n; i++) pos1[i].shape_idx = i;
+                    std::shuffle(pos1.begin(), pos1.end(), rng);
+                    std::vector<shape_pos> pos2 = pos1;
+
+                    shape::arrange_circle(radius, variations, pos1);
+                    seeder.arrange(pos2, table);
+                    Assert::IsTrue(pos1 == pos2);
+                }
+            }
+        }
+    }
+
+    TEST_METHOD(test_shape_library) {
+        std::string dir(__FILE__);
+        dir = dir.substr(0, dir.find_last_of("/\\") + 1) + "../../data/";
+        for (const char* name : {"tetrominoes.txt", "pentominoes.txt"}) {
+            std::ifstream ifs(dir + name);
+            std::vector<shape> shapes = shape::parse(ifs);
+            shape::variation_array variations;
+            for (const auto& sh : shapes) variations.push_back(sh.get_variations());
+            const int n = (int)shapes.size();
+            pair_table table(variations, 4);
+            shape_library lib(variations);
+
+            //  the same variants in the same order
+            Assert::AreEqual(n, lib.num_shapes());
+            Assert::AreEqual(table.get_num_vars(), lib.num_vars());
+            for (int s = 0; s < n; s++) {
+                Assert::AreEqual((int)variations[s].size(), lib.num_variants(s));
+                for (int v = 0; v < lib.num_variants(s); v++) {
+                    const shape& sh = variations[s][v];
+                    const shape_library::variant& var = lib.get(shape_pos{0, 0, (uint16_t)s, (uint16_t)v});
+                    Assert::AreEqual(sh.width, (int)var.width);
+                    Assert::AreEqual(sh.height, (int)var.height);
+                    Assert::AreEqual(s, (int)var.shape_idx);
+                    Assert::AreEqual((int)sh.squares.size(), lib.squares(var).size());
+                    for (int i = 0; i < lib.squares(var).size(); i++) {
+                        Assert::IsTrue(sh.squares[i] == lib.squares(var).begin()[i].p());
+                    }
+                    Assert::AreEqual((int)sh.get_boundary().size(), lib.boundary(var).size());
+                    for (int y = 0; y < sh.height; y++) {
+                        for (int x = 0; x < sh.width; x++) {
+                            Assert::AreEqual(sh.is_set(x, y), ((lib.rows(var)[y] >> x) & 1) != 0);
+                        }
+                    }
+                }
+            }
+
+            //  the layout functions agree with the shape:: ones, on both the closed and the open rings
+            circle_seeder seeder(lib, 5.0, table);
+            mutation_log log;
+            for (int k = 0; k < 40; k++) {
+                philox_rng rng(31, k, 0, 0);
+                std::vector<shape_pos> pos(n, {0, 0, 0, 0});
+                for (int i = 0; i < n; i++) pos[i].shape_idx = i;
+                std::shuffle(pos.begin(), pos.end(), rng);
+                seeder.arrange(pos, table);
+                log.clear();
+                if (k%2) mutate(variations, 1, 4, pos, log, rng);
+
+                vec2i lt1, rb1, lt2, rb2;
+                shape::get_bounds(variations, pos, lt1, rb1);
+                lib.get_bounds(pos, lt2, rb2);
+                Assert::IsTrue(lt1 == lt2 && rb1 == rb2);
+
+                bitboard board;
+                for (area_method method : {area_method::FloodFill, area_method::Contour}) {
+                    Assert::AreEqual(shape::score(variations, pos, table, board, method), lib.score(pos, table, board, method));
+                }
+                Assert::AreEqual(shape::contour_area(variations, pos), lib.contour_area(pos));
+
+                std::vector<shape_pos> pos2 = pos;
+                shape::center(variations, pos);
+                lib.center(pos2);
+                Assert::IsTrue(pos == pos2);
+            }
+        }
+    }
+
+};
+
+TEST_CLASS(test_philox)
+{
+public:
+
+    TEST_METHOD(test_philox_known_answers) {
+        //  the known-answer vectors from the Random123 distribution
+        const uint32_t ctr0[4] = {0, 0, 0, 0}, key0[2] = {0, 0};
+        const uint32_t ctr1[4] = {0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF, 0xFFFFFFFF}, key1[2] = {0xFFFFFFFF, 0xFFFFFFFF};
+        const uint32_t ctr2[4] = {0x243F6A88, 0x85A308D3, 0x13198A2E, 0x03707344}, key2[2] = {0xA4093822, 0x299F31D0};
+        uint32_t out[4];
+
+        philox4x32(ctr0, key0, out);
+        Assert::AreEqual(0x6627E8D5u, out[0]);
+        Assert::AreEqual(0x9B00DBD8u, out[3]);
+
+        philox4x32(ctr1, key1, out);
+        Assert::AreEqual(0x408F276Du, out[0]);
+        Assert::AreEqual(0x6D5451FDu, out[3]);
+
+        philox4x32(ctr2, key2, out);
+        Assert::AreEqual(0xD16CFE09u, out[0]);
+        Assert::AreEqual(0x94FDCCEBu, out[1]);
+        Assert::AreEqual(0x5001E420u, out[2]);
+        Assert::AreEqual(0x24126EA1u, out[3]);
+    }
+
+    TEST_METHOD(test_philox_streams) {
+        //  the same key gives the same stream, any of the key parts changes it
+        philox_rng a(12345, 1, 2, 3), b(12345, 1, 2, 3);
+        philox_rng c(12345, 1, 2, 4), d(12346, 1, 2, 3);
+        bool differ_c = false, differ_d = false;
+        for (int i = 0; i < 100; i++) {
+            const uint32_t x = a();
+            Assert::AreEqual(x, b());
+            differ_c |= (x != c());
+            differ_d |= (x != d());
+        }
+        Assert::IsTrue(differ_c);
+        Assert::IsTrue(differ_d);
+
+        std::vector<int> hist(10, 0);
+        for (int i = 0; i < 100000; i++) {
+            const uint32_t x = a.below(10);
+            Assert::IsTrue(x < 10);
+            hist[x]++;
+        }
+        for (int h : hist) Assert::IsTrue(h > 9500 && h < 10500);
+    }
+
+};
+
+TEST_CLASS(test_mutation)
+{
+public:
+
+    TEST_METHOD(test_undo_redo) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE3), sh);
+        shape::variation_array variations(10, sh.get_variations());
+
+        std::vector<shape_pos> parent;
+        for (int i = 0; i < 10; i++) parent.push_back(shape_pos::at({i*3, -i}, i, i%8));
+
+        mutation_log log;
+        log.set_key(layout_key(parent));
+        for (uint32_t retry = 0; retry < 200; retry++) {
+            std::vector<shape_pos> target = parent;
+            philox_rng rng(1, 2, 3, retry);
+            mutate(variations, 2, 4, target, log, rng);
+            Assert::IsTrue(log.ops.size() >= 2 && log.ops.size() <= 4);
+            Assert::AreEqual(layout_key(target), log.key);
+
+            //  only the logged positions change
+            std::vector<shape_pos> replayed = parent;
+            mutation_log::redo(replayed, log.ops);
+            Assert::IsTrue(replayed == target);
+            for (int i = 0; i < 10; i++) {
+                bool logged = std::find(log.changed.begin(), log.changed.end(), i) != log.changed.end();
+                Assert::IsTrue(logged || target[i] == parent[i]);
+            }
+
+            log.undo(target);
+            Assert::IsTrue(target == parent);
+            Assert::IsTrue(log.ops.empty() && log.changed.empty());
+            Assert::AreEqual(layout_key(parent), log.key);
+        }
+    }
+
+};
+
+TEST_CLASS(test_op_scheduler)
+{
+public:
+
+    TEST_METHOD(test_uniform_picks) {
+        op_scheduler sched(2, 4);
+        uniform_ops uniform = {2, 4};
+        for (uint32_t i = 0; i < 10000; i++) {
+            philox_rng rng1(5, i, 0, 0), rng2(5, i, 0, 0);
+            Assert::AreEqual(uniform.pick_flips(rng1), sched.pick_flips(rng2));
+            Assert::IsTrue(uniform.pick_type(rng1) == sched.pick_type(rng2));
+        }
+    }
+
+    TEST_METHOD(test_adaptation) {
+        op_scheduler sched(1, 2, true);
+        std::vector<mutation> shift_ops(1), swap_ops(2);
+        shift_ops[0].type = mutation_type::Shift;
+        swap_ops[0].type = swap_ops[1].type = mutation_type::Swap;
+
+        //  the single shifts keep improving, the double swaps never do
+        op_stats stats;
+        for (int it = 0; it < 10; it++) {
+            for (int i = 0; i < 100; i++) {
+                stats.record(shift_ops, 1, 12, 10);
+                stats.record(swap_ops, 1, 8, 10);
+            }
+            sched.update(stats);
+            stats.clear();
+        }
+        Assert::IsTrue(sched.type_prob((int)mutation_type::Shift) > 0.85);
+        Assert::AreEqual(0.05, sched.type_prob((int)mutation_type::Swap), 1e-9);
+        Assert::AreEqual(0.95, sched.flips_prob(1), 1e-9);
+        Assert::AreEqual(1000ull, (unsigned long long)sched.get_totals().types[(int)mutation_type::Shift].uses);
+        Assert::AreEqual(2000ull, (unsigned long long)sched.get_totals().types[(int)mutation_type::Swap].uses);
+        Assert::AreEqual(0ull, (unsigned long long)sched.get_totals().flips[1].improvements);
+
+        int hist[3] = {};
+        for (uint32_t i = 0; i < 10000; i++) {
+            philox_rng rng(7, i, 0, 0);
+            hist[(int)sched.pick_type(rng)]++;
+        }
+        Assert::IsTrue(hist[(int)mutation_type::Shift] > 8500);
+        Assert::IsTrue(hist[(int)mutation_type::Swap] > 300 && hist[(int)mutation_type::Swap] < 700);
+    }
+
+};
+
+TEST_CLASS(test_selection)
+{
+public:
+
+    TEST_METHOD(test_alias_table) {
+        const double weights[5] = {1, 0, 3, 6, 10};
+        alias_table table;
+        table.build(weights, 5);
+        Assert::AreEqual(5, table.size());
+
+        int hist[5] = {};
+        for (uint32_t i = 0; i < 200000; i++) {
+            philox_rng rng(9, i, 0, 0);
+            hist[table.sample(rng)]++;
+        }
+        Assert::AreEqual(0, hist[1]);
+        for (int i = 0; i < 5; i++) Assert::AreEqual(weights[i]/20, hist[i]/200000.0, 0.005);
+    }
+
+    TEST_METHOD(test_partition) {
+        std::vector<int> vals(1000);
+        for (int i = 0; i < 1000; i++) vals[i] = (i*7919)%1000;
+
+        const int bounds[4] = {10, 250, 500, 999};
+        partition_at(vals.begin(), vals.end(), bounds, 4, std::less<int>());
+        for (int b : bounds) {
+            Assert::AreEqual(b, vals[b]);
+            for (int i = 0; i < b; i++) Assert::IsTrue(vals[i] < b);
+        }
+
+        sort_head(vals.begin(), vals.end(), 20, std::greater<int>());
+        for (int i = 0; i < 20; i++) Assert::AreEqual(999 - i, vals[i]);
+        for (int i = 20; i < 1000; i++) Assert::IsTrue(vals[i] < 980);
+    }
+
+    TEST_METHOD(test_tournament) {
+        //  the best of 4 out of 100 is in the top 20 with the probability of 1 - 0.8^4 = 0.59
+        int top = 0;
+        for (uint32_t i = 0; i < 10000; i++) {
+            philox_rng rng(3, i, 0, 0);
+            if (tournament(100, 4, rng, [](int a, int b) { return a < b; }) < 20) top++;
+        }
+        Assert::IsTrue(top > 5700 && top < 6100);
+    }
+
+    TEST_METHOD(test_rank_pick) {
+        //  P(idx < n/2) = 1/4, also for the generations too big for the 32-bit n^2
+        for (int n : {100, 46341, 3000000}) {
+            int low = 0;
+            for (uint32_t i = 0; i < 10000; i++) {
+                philox_rng rng(5, i, 0, 0);
+                const int idx = rank_pick(n, rng);
+                Assert::IsTrue(idx >= 0 && idx < n);
+                if (idx < n/2) low++;
+            }
+            Assert::IsTrue(low > 2350 && low < 2650);
+        }
+    }
+
+    TEST_METHOD(test_population_head) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+        auto for_each = [](int count, auto&& fn) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+        };
+
+        for (selection_method method : {selection_method::Tournament, selection_method::RankBuckets}) {
+            ga_config cfg = {60, 1, 0.9, 8, 2, 4, 4, 777};
+            cfg.selection = method;
+            cfg.rank_buckets = 8;
+            cfg.sorted_head = 10;
+            population pop(lib, table, 3.0, cfg);
+            std::vector<eval_context> contexts;
+            contexts.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+
+            pop.init(contexts, for_each);
+            double prev = pop.best_score();
+            for (int it = 0; it < 5; it++) {
+                pop.step(it, contexts, for_each);
+                Assert::IsTrue(pop.best_score() >= prev);
+                prev = pop.best_score();
+
+                //  the head is in order, and nothing after it is any better
+                const auto& ranked = pop.ranked();
+                for (int i = 1; i < 10; i++) Assert::IsTrue(ranked[i - 1].score >= ranked[i].score);
+                for (int i = 10; i < 60; i++) Assert::IsTrue(ranked[9].score >= ranked[i].score);
+            }
+        }
+    }
+
+};
+
+TEST_CLASS(test_layout_arena)
+{
+public:
+    TEST_METHOD(test_rows) {
+        Assert::AreEqual(8, (int)sizeof(shape_pos));
+
+        layout_arena a, b;
+        a.resize(5, 3);
+        b.resize(5, 3);
+        Assert::AreEqual(5, a.size());
+        Assert::AreEqual(3, a.get_stride());
+        Assert::AreEqual((size_t)5*(3*sizeof(shape_pos) + sizeof(double)), a.memory_size());
+
+        for (int i = 0; i < a.size(); i++) {
+            layout_ref row = a.row(i);
+            Assert::AreEqual((size_t)3, row.size());
+            for (int k = 0; k < 3; k++) row[k] = {(int16_t)(i - 2), (int16_t)-k, (uint16_t)k, (uint16_t)i};
+            a.score(i) = i*10.0;
+        }
+        //  the rows are back to back
+        Assert::IsTrue(a.row(1).data() == a.row(0).data() + 3);
+
+        //  swapping keeps the rows where they were
+        const shape_pos* first = a.row(0).data();
+        a.swap(b);
+        Assert::IsTrue(b.row(0).data() == first);
+        for (int i = 0; i < b.size(); i++) {
+            Assert::AreEqual(i*10.0, b.score(i));
+            Assert::AreEqual(-2, (int)b.row(i)[2].y);
+            Assert::AreEqual(i - 2, (int)b.row(i)[0].x);
+        }
+        std::vector<shape_pos> copy(b.row(4).begin(), b.row(4).end());
+        Assert::IsTrue(b.row(4) == copy);
+        Assert::IsFalse(b.row(3) == copy);
+    }
+
+    TEST_METHOD(test_population_memory) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        ga_config cfg = {1000, 2, 0.8, 4, 1, 3, 1, 7};
+        population pop(lib, table, 3.0, cfg);
+        Assert::AreEqual((size_t)2*1000*(6*sizeof(shape_pos) + sizeof(double)), pop.memory_size());
+
+        std::vector<eval_context> contexts;
+        contexts.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+        auto for_each = [](int count, auto&& fn) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+        };
+        pop.init(contexts, for_each);
+        for (int it = 0; it < 2; it++) pop.step(it, contexts, for_each);
+        for (int k = 0; k < pop.size(); k += 97) {
+            Assert::AreEqual(pop.ranked()[k].score, shape::score(variations, pop.layout(k)));
+        }
+    }
+};
+
+TEST_CLASS(test_layout_hash)
+{
+public:
+
+    TEST_METHOD(test_canonical_hash) {
+        shape sh1, sh2, sh3;
+        shape::parse(std::stringstream(SHAPE1), sh1);
+        shape::parse(std::stringstream(SHAPE2), sh2);
+        shape::parse(std::stringstream(SHAPE3), sh3);
+        shape::variation_array variations = {sh1.get_variations(), sh2.get_variations(), sh3.get_variations()};
+        layout_hasher plain(variations), dihedral(variations, true);
+
+        std::vector<shape_pos> layout = {{0, 0, 0, 1}, {3, 1, 1, 2}, {1, 4, 2, 3}};
+        const uint64_t h = plain(layout), hd = dihedral(layout);
+
+        //  translated
+        std::vector<shape_pos> moved = layout;
+        for (auto& p : moved) {
+            p.x += 7;
+            p.y -= 3;
+        }
+        Assert::IsTrue(h == plain(moved));
+
+        //  the ring starting from another shape, and going the other way
+        std::vector<shape_pos> rotated = {layout[1], layout[2], layout[0]};
+        std::vector<shape_pos> reversed = {layout[2], layout[1], layout[0]};
+        Assert::IsTrue(h == plain(rotated));
+        Assert::IsTrue(h == plain(reversed));
+
+        //  a different variant or position
+        std::vector<shape_pos> other = layout;
+        other[1].var_idx = 0;
+        Assert::IsFalse(h == plain(other));
+        other = layout;
+        other[2].x++;
+        Assert::IsFalse(h == plain(other));
+
+        //  turned by 90 degrees as a whole: (x, y) -> (-y, x)
+        std::vector<shape_pos> turned = layout;
+        for (auto& p : turned) {
+            const shape& v = variations[p.shape_idx][p.var_idx];
+            shape r = v.rotated(rotation::CW_90);
+            int var = (int)(std::find(variations[p.shape_idx].begin(), variations[p.shape_idx].end(), r) - 
+                variations[p.shape_idx].begin());
+            Assert::IsTrue(var < (int)variations[p.shape_idx].size());
+            p = shape_pos::at({-p.y - v.height + 1, p.x}, p.shape_idx, var);
+        }
+        Assert::IsFalse(h == plain(turned));
+        Assert::IsTrue(hd == dihedral(turned));
+    }
+
+    TEST_METHOD(test_hash_set) {
+        hash_set set;
+        set.reserve(4);
+        for (uint64_t i = 0; i < 100; i++) Assert::IsTrue(set.insert(mix64(i + 1)));
+        for (uint64_t i = 0; i < 100; i++) Assert::IsFalse(set.insert(mix64(i + 1)));
+        Assert::AreEqual(100, set.size());
+        Assert::IsTrue(set.insert(0));
+        Assert::IsFalse(set.insert(0));
+        set.clear();
+        Assert::AreEqual(0, set.size());
+        Assert::IsTrue(set.insert(mix64(5)));
+    }
+
+};
+
+TEST_CLASS(test_score_cache)
+{
+public:
+
+    TEST_METHOD(test_find_insert) {
+        score_cache cache(1 << 12);
+        Assert::IsTrue(cache.memory_size() <= (1 << 12));
+        Assert::AreEqual(cache.memory_size()/16, cache.capacity());
+
+        double score = 0;
+        Assert::IsFalse(cache.find(mix64(1), score));
+        cache.insert(mix64(1), -17, 0);
+        cache.insert(mix64(2), 42, 0);
+        Assert::IsTrue(cache.find(mix64(1), score));
+        Assert::AreEqual(-17.0, score);
+        Assert::IsTrue(cache.find(mix64(2), score));
+        Assert::AreEqual(42.0, score);
+
+        //  overfill it, the entries that remain are the right ones
+        const int n = (int)cache.capacity()*4;
+        for (int i = 0; i < n; i++) cache.insert(mix64(i + 100), i, i);
+        int found = 0;
+        for (int i = 0; i < n; i++) {
+            if (cache.find(mix64(i + 100), score)) {
+                Assert::AreEqual((double)i, score);
+                found++;
+            }
+        }
+        Assert::IsTrue(found > 0 && found <= (int)cache.capacity());
+
+        //  the newest ones are kept
+        Assert::IsTrue(cache.find(mix64(n - 1 + 100), score));
+
+        cache.clear();
+        Assert::IsFalse(cache.find(mix64(n - 1 + 100), score));
+    }
+
+    TEST_METHOD(test_concurrent_insert) {
+        score_cache cache(1 << 16);
+        task_pool pool(4);
+        pool.parallel_for(20000, [&](int i, int) {
+            const uint64_t key = mix64(i%3000 + 1);
+            double score;
+            if (cache.find(key, score)) Assert::AreEqual((double)(i%3000), score);
+            cache.insert(key, i%3000, i/3000);
+        }, 16);
+    }
+
+    TEST_METHOD(test_population_scores) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        //  the cache only saves the work, the results stay the same
+        ga_config cfg = {20, 1, 0.9, 8, 2, 4, 4, 777};
+        score_cache cache(1 << 16);
+        population pop1(lib, table, 3.0, cfg), pop2(lib, table, 3.0, cfg, 0, &cache);
+        std::vector<eval_context> ctx1, ctx2;
+        ctx1.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+        ctx2.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+        auto for_each = [](int count, auto&& fn) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+        };
+
+        pop1.init(ctx1, for_each);
+        pop2.init(ctx2, for_each);
+        for (int it = 0; it < 8; it++) {
+            pop1.step(it, ctx1, for_each);
+            pop2.step(it, ctx2, for_each);
+            for (int i = 0; i < pop1.size(); i++) {
+                Assert::AreEqual(pop1.ranked()[i].score, pop2.ranked()[i].score);
+                Assert::IsTrue(pop1.layout(i) == pop2.layout(i));
+            }
+        }
+        Assert::IsTrue(ctx2[0].cache_hits > 0);
+    }
+
+};
+
+TEST_CLASS(test_solvers)
+{
+public:
+
+    static void check_local_search(local_search& ls1, local_search& ls2, const shape::variation_array& variations) {
+        ls1.init();
+        ls2.init();
+        double prev = ls1.best_score();
+        for (int it = 0; it < 10; it++) {
+            ls1.step(it);
+            ls2.step(it);
+
+            //  the best one never gets lost, and the runs are reproducible
+            Assert::IsTrue(ls1.best_score() >= prev);
+            prev = ls1.best_score();
+            Assert::AreEqual(ls1.best_score(), shape::score(variations, ls1.get_best()));
+            Assert::IsTrue(ls1.get_best() == ls2.get_best());
+        }
+        Assert::AreEqual((size_t)(1 + 10*200), ls1.num_evals());
+    }
+
+    TEST_METHOD(test_annealing) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE3), sh);
+        shape::variation_array variations(8, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        local_search_config cfg = {200, 2, 4, 99};
+        eval_context ctx1(lib, &table, cfg.max_flips), ctx2(lib, &table, cfg.max_flips);
+        annealing_solver ls1(lib, table, 4.0, cfg, ctx1), ls2(lib, table, 4.0, cfg, ctx2);
+        check_local_search(ls1, ls2, variations);
+    }
+
+    TEST_METHOD(test_tabu) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE3), sh);
+        shape::variation_array variations(8, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        local_search_config cfg = {200, 2, 4, 99};
+        cfg.tabu_candidates = 20;
+        cfg.tabu_tenure = 8;
+        eval_context ctx1(lib, &table, cfg.max_flips), ctx2(lib, &table, cfg.max_flips);
+        tabu_solver ls1(lib, table, 4.0, cfg, ctx1), ls2(lib, table, 4.0, cfg, ctx2);
+        check_local_search(ls1, ls2, variations);
+    }
+
+    TEST_METHOD(test_hybrid) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        ga_config cfg = {20, 1, 0.9, 8, 2, 4, 4, 777};
+        local_search_config lcfg = {100, 2, 4, 777};
+        task_pool pool(2);
+        std::vector<eval_context> contexts;
+        for (int i = 0; i < pool.size(); i++) contexts.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+        tabu_solver polisher(lib, table, 3.0, lcfg, contexts[0]);
+        hybrid_solver hybrid(lib, table, 3.0, cfg, pool, contexts, polisher, 2);
+
+        hybrid.init();
+        for (int it = 0; it < 5; it++) {
+            hybrid.step(it);
+            //  the polished one makes it into the population
+            Assert::IsTrue(hybrid.best_score() >= polisher.best_score());
+        }
+        std::vector<const_layout_ref> ranked;
+        hybrid.get_ranked(ranked);
+        Assert::AreEqual(20, (int)ranked.size());
+        Assert::AreEqual(hybrid.best_score(), shape::score(variations, ranked[0]));
+        Assert::AreEqual(hybrid.get_population().num_evals() + polisher.num_evals(), hybrid.num_evals());
+    }
+
+};
+
+TEST_CLASS(test_branch_bound)
+{
+public:
+
+    TEST_METHOD(test_pinwheel) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(4, sh.get_variations());
+
+        //  four sticks of 4 make a pinwheel around a 3x3 hole, and nothing can do better
+        for (int nthreads = 1; nthreads <= 3; nthreads += 2) {
+            task_pool pool(nthreads);
+            branch_bound bb(variations);
+            Assert::IsTrue(bb.run(pool));
+            Assert::AreEqual(9.0, bb.best_score());
+            Assert::AreEqual(9.0, shape::score(variations, bb.get_best()));
+            Assert::IsTrue(bb.get_num_nodes() > 0);
+            Assert::IsTrue(bb.proven());
+        }
+    }
+
+    TEST_METHOD(test_budgets) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(10, sh.get_variations());
+
+        //  the workers stop within a check interval each once the nodes run out
+        task_pool pool(2);
+        branch_bound bb(variations);
+        bb.run(pool, nullptr, 20000);
+        Assert::IsFalse(bb.proven());
+        Assert::IsTrue(bb.get_reason() == stop_reason::MaxNodes);
+        Assert::IsTrue(bb.get_num_nodes() >= 20000 && bb.get_num_nodes() < 20000 + 3*4096);
+
+        run_controller ctl({1, 0.05, 0});
+        bb.run(pool, &ctl);
+        Assert::IsFalse(bb.proven());
+        Assert::IsTrue(bb.get_reason() == stop_reason::Deadline);
+        Assert::IsTrue(bb.get_ms() < 1000);
+        if (!bb.get_best().empty()) {
+            Assert::AreEqual(bb.best_score(), shape::score(variations, bb.get_best()));
+        }
+    }
+
+    TEST_METHOD(test_nothing_enclosed) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE5), sh);
+        shape::variation_array variations(3, sh.get_variations());
+
+        task_pool pool(2);
+        branch_bound bb(variations);
+        Assert::IsFalse(bb.run(pool));
+        Assert::IsTrue(bb.get_best().empty());
+    }
+
+};
+
+TEST_CLASS(test_run_control)
+{
+public:
+
+    TEST_METHOD(test_stop_rules) {
+        run_controller ctl1({5, 0, 0});
+        int it = 0;
+        for (; ctl1.keep_going(it); it++) ctl1.iteration_done(it);
+        Assert::AreEqual(5, it);
+        Assert::IsTrue(ctl1.get_reason() == stop_reason::MaxIter);
+
+        //  improves for the first 3 iterations, then stalls
+        run_controller ctl2({100, 0, 4});
+        for (it = 0; ctl2.keep_going(it); it++) ctl2.iteration_done(std::min(it, 2));
+        Assert::AreEqual(7, it);
+        Assert::IsTrue(ctl2.get_reason() == stop_reason::Stagnation);
+
+        //  the iterations take ~20ms, so the 4th one would not fit into 70ms
+        run_controller ctl3({100, 0.07, 0});
+        for (it = 0; ctl3.keep_going(it); it++) {
+            std::this_thread::sleep_for(std::chrono::milliseconds(20));
+            ctl3.iteration_done(it);
+        }
+        Assert::IsTrue(ctl3.get_reason() == stop_reason::Deadline);
+        Assert::IsTrue(it >= 1 && it <= 3);
+        Assert::IsFalse(ctl3.has_time_for(0.05));
+    }
+
+};
+
+TEST_CLASS(test_checkpoint)
+{
+public:
+
+    TEST_METHOD(test_save_resume) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+        const char* path = "test_checkpoint.bin";
+
+        ga_config cfg = {20, 1, 0.9, 8, 2, 4, 4, 555};
+        std::vector<eval_context> contexts;
+        contexts.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+        auto for_each = [](int count, auto&& fn) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+        };
+
+        //  a straight run of 6 iterations, with a checkpoint after the 3rd one
+        population pop1(lib, table, 3.0, cfg);
+        pop1.init(contexts, for_each);
+        for (int it = 0; it < 6; it++) {
+            pop1.step(it, contexts, for_each);
+            if (it == 2) {
+                std::vector<const_layout_ref> layouts;
+                std::vector<double> scores;
+                for (int k = 0; k < pop1.size(); k++) {
+                    layouts.push_back(pop1.layout(k));
+                    scores.push_back(pop1.ranked()[k].score);
+                }
+                Assert::IsTrue(checkpoint::save(path, variations, it + 1, cfg.seed, pop1.get_scheduler().get_state(), 
+                    layouts, scores));
+            }
+        }
+
+        checkpoint ck;
+        Assert::IsTrue(ck.load(path, variations));
+        Assert::AreEqual(3, ck.get_iteration());
+        Assert::AreEqual((uint64_t)555, ck.get_seed());
+        Assert::AreEqual(20, ck.num_layouts());
+        auto get = [&](int i, layout_ref pos) {
+            ck.get_layout(i, pos);
+            return ck.get_score(i);
+        };
+
+        //  continuing from it ends up at the same place
+        population pop2(lib, table, 3.0, cfg);
+        pop2.restore(ck.num_layouts(), get, ck.get_iteration(), ck.get_ops(), contexts, for_each);
+        for (int it = ck.get_iteration(); it < 6; it++) pop2.step(it, contexts, for_each);
+        for (int i = 0; i < pop1.size(); i++) {
+            Assert::AreEqual(pop1.ranked()[i].score, pop2.ranked()[i].score);
+            Assert::IsTrue(pop1.layout(i) == pop2.layout(i));
+        }
+
+        //  and it can seed the bigger and the smaller generations
+        for (int gen_size : {7, 50}) {
+            ga_config cfg2 = cfg;
+            cfg2.generation_size = gen_size;
+            population pop3(lib, table, 3.0, cfg2);
+            pop3.restore(ck.num_layouts(), get, ck.get_iteration(), ck.get_ops(), contexts, for_each);
+            Assert::AreEqual(ck.get_score(0), pop3.best_score());
+            for (int k = 0; k < pop3.size(); k++) {
+                Assert::AreEqual(pop3.ranked()[k].score, shape::score(variations, pop3.layout(k)));
+            }
+        }
+
+        //  a different set of shapes can't use it
+        shape::variation_array other(5, sh.get_variations());
+        Assert::IsFalse(ck.load(path, other));
+
+        //  neither can a damaged file
+        ck.close();
+        FILE* f = fopen(path, "r+b");
+        fseek(f, 100, SEEK_SET);
+        const int byte = fgetc(f);
+        fseek(f, 100, SEEK_SET);
+        fputc(byte ^ 0xFF, f);
+        fclose(f);
+        Assert::IsFalse(ck.load(path, variations));
+        std::remove(path);
+    }
+
+    TEST_METHOD(test_resume_adaptive_ops) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+        const char* path = "test_checkpoint_ops.bin";
+
+        ga_config cfg = {20, 1, 0.9, 8, 2, 4, 4, 777};
+        cfg.adaptive_ops = true;
+        std::vector<eval_context> contexts;
+        contexts.emplace_back(lib, &table, cfg.max_flips, cfg.retry_block_size);
+        auto for_each = [](int count, auto&& fn) {
+            for (int i = 0; i < count; i++) fn(i, 0);
+        };
+
+        //  the probabilities have moved away from the uniform ones by the checkpoint
+        population pop1(lib, table, 3.0, cfg);
+        pop1.init(contexts, for_each);
+        const int ncheck = 4, niter = 10;
+        for (int it = 0; it < niter; it++) {
+            pop1.step(it, contexts, for_each);
+            if (it == ncheck - 1) {
+                std::vector<const_layout_ref> layouts;
+                std::vector<double> scores;
+                for (int k = 0; k < pop1.size(); k++) {
+                    layouts.push_back(pop1.layout(k));
+                    scores.push_back(pop1.ranked()[k].score);
+                }
+                const op_scheduler& sched = pop1.get_scheduler();
+                Assert::IsTrue(sched.type_prob(0) != 1.0/3 || sched.flips_prob(cfg.min_flips) != 1.0/3);
+                Assert::IsTrue(checkpoint::save(path, variations, it + 1, cfg.seed, sched.get_state(), 
+                    layouts, scores));
+            }
+        }
+
+        checkpoint ck;
+        Assert::IsTrue(ck.load(path, variations));
+        population pop2(lib, table, 3.0, cfg);
+        pop2.restore(ck.num_layouts(), [&](int i, layout_ref pos) {
+            ck.get_layout(i, pos);
+            return ck.get_score(i);
+        }, ck.get_iteration(), ck.get_ops(), contexts, for_each);
+        for (int it = ck.get_iteration(); it < niter; it++) pop2.step(it, contexts, for_each);
+
+        //  the same choices, the same statistics and the same generation as the uninterrupted run
+        const op_scheduler& s1 = pop1.get_scheduler();
+        const op_scheduler& s2 = pop2.get_scheduler();
+        for (int t = 0; t < op_stats::NUM_TYPES; t++) {
+            Assert::AreEqual(s1.type_prob(t), s2.type_prob(t));
+            Assert::AreEqual(s1.get_totals().types[t].uses, s2.get_totals().types[t].uses);
+            Assert::AreEqual(s1.get_totals().types[t].gain, s2.get_totals().types[t].gain);
+        }
+        for (int f = cfg.min_flips; f <= cfg.max_flips; f++) Assert::AreEqual(s1.flips_prob(f), s2.flips_prob(f));
+        for (int i = 0; i < pop1.size(); i++) {
+            Assert::AreEqual(pop1.ranked()[i].score, pop2.ranked()[i].score);
+            Assert::IsTrue(pop1.layout(i) == pop2.layout(i));
+        }
+        ck.close();
+        std::remove(path);
+    }
+
+};
+
+TEST_CLASS(test_svg_gen)
+{
+public:
+
+    TEST_METHOD(test_path_cache) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(4, sh.get_variations());
+        std::vector<shape_pos> positions = {{0, 0, 0, 0}, {4, 0, 1, 1}, {1, 4, 2, 0}, {0, 1, 3, 1}};
+
+        //  the cached paths render the same, for every cell side
+        svg_path_cache paths(variations);
+        for (int cell_side : {10, 15, 10}) {
+            std::stringstream plain, cached;
+            create_svg(plain, variations, positions, nullptr, nullptr, cell_side);
+            create_svg(cached, paths, positions, nullptr, nullptr, cell_side);
+            Assert::IsTrue(plain.str() == cached.str());
+        }
+        Assert::IsTrue(&paths.get(1, 1, 10, 1) == &paths.get(1, 1, 10, 1));
+        Assert::IsTrue(paths.get(1, 1, 10, 1) != paths.get(1, 1, 15, 1));
+        Assert::IsTrue(paths.get(1, 1, 10, 1) != paths.get(1, 1, 10, 0));
+    }
+
+};
+
+TEST_CLASS(test_result_writer)
+{
+public:
+
+    TEST_METHOD(test_write_on_change) {
+        shape sh1, sh2, sh3;
+        shape::parse(std::stringstream(SHAPE1), sh1);
+        shape::parse(std::stringstream(SHAPE2), sh2);
+        shape::parse(std::stringstream(SHAPE3), sh3);
+        shape::variation_array variations = {sh1.get_variations(), sh2.get_variations(), sh3.get_variations()};
+        layout_hasher hasher(variations);
+        const char* path = "test_result.html";
+        auto read_file = [&]() {
+            std::ifstream ifs(path);
+            std::stringstream ss;
+            ss << ifs.rdbuf();
+            return ss.str();
+        };
+        auto num_svgs = [](const std::string& html) {
+            int n = 0;
+            for (size_t p = html.find("<svg"); p != std::string::npos; p = html.find("<svg", p + 1)) n++;
+            return n;
+        };
+
+        std::vector<shape_pos> layout1 = {{0, 0, 0, 1}, {3, 1, 1, 2}, {1, 4, 2, 3}};
+        std::vector<shape_pos> layout2 = {{0, 0, 0, 0}, {4, 0, 1, 0}, {0, 4, 2, 0}};
+        std::vector<shape_pos> moved = layout1;
+        for (auto& p : moved) p.x += 5;
+
+        {
+            //  the interval never passes during the test, so past the first write only flush() gets them written
+            result_writer writer(variations, hasher, path, 60*60*1000);
+            std::vector<const_layout_ref> ranked = {layout1, moved, layout2};
+            writer.post(ranked);
+            writer.flush();
+            Assert::AreEqual(1, writer.num_written());
+            //  the translated copy of the first layout doesn't get shown
+            const std::string html1 = read_file();
+            Assert::AreEqual(2, num_svgs(html1));
+
+            //  the same set again gets skipped, the newer one replaces the pending one
+            writer.post(ranked);
+            writer.flush();
+            Assert::AreEqual(1, writer.num_written());
+            Assert::AreEqual(1, writer.num_unchanged());
+
+            ranked = {layout2};
+            writer.post(ranked);
+            ranked = {layout2, layout1};
+            writer.post(ranked);
+            writer.flush();
+            Assert::AreEqual(2, writer.num_written());
+            Assert::IsTrue(read_file() != html1);
+
+            //  whatever is still pending gets written out when it's destroyed
+            ranked = {layout1};
+            writer.post(ranked);
+        }
+        Assert::AreEqual(1, num_svgs(read_file()));
+        std::ifstream tmp(std::string(path) + ".tmp");
+        Assert::IsFalse(tmp.good());
+        std::remove(path);
+    }
+
+};
+
+TEST_CLASS(test_task_pool)
+{
+public:
+
+    TEST_METHOD(test_parallel_for) {
+        task_pool pool(4);
+        Assert::AreEqual(4, pool.size());
+
+        for (int grain : {1, 7, 1000}) {
+            std::vector<int> visited(1000, 0), workers(1000, -1);
+            pool.parallel_for(1000, [&](int i, int worker) {
+                visited[i]++;
+                workers[i] = worker;
+            }, grain);
+            for (int i = 0; i < 1000; i++) {
+                Assert::AreEqual(1, visited[i]);
+                Assert::IsTrue(workers[i] >= 0 && workers[i] < pool.size());
+            }
+        }
+
+        //  uneven work gets stolen
+        std::vector<int> res(64, 0);
+        pool.parallel_for(64, [&](int i, int) {
+            int sum = 0;
+            for (int k = 0; k < (i < 16 ? 100000 : 10); k++) sum += k%7;
+            res[i] = sum;
+        });
+        Assert::AreEqual(res[0], res[15]);
+        Assert::AreEqual(res[16], res[63]);
+
+        pool.parallel_for(0, [&](int, int) { Assert::Fail(); });
+    }
+
+};
+
+TEST_CLASS(test_islands)
+{
+public:
+
+    TEST_METHOD(test_mailbox) {
+        std::vector<std::vector<shape_pos>> out = {{{1, 2, 0, 0}}, {{3, 4, 1, 0}}}, in;
+        mailbox box;
+        Assert::AreEqual(0, box.take(in));
+        Assert::IsTrue(box.post(out, 2));
+        Assert::IsFalse(box.post(out, 1));
+        Assert::AreEqual(2, box.take(in));
+        Assert::IsTrue(out[0] == in[0] && out[1] == in[1]);
+        Assert::AreEqual(0, box.take(in));
+        Assert::IsTrue(box.post(out, 1));
+        Assert::AreEqual(1, box.take(in));
+    }
+
+    TEST_METHOD(test_island_model) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        ga_config cfg = {20, 1, 0.9, 8, 2, 4, 4, 12345};
+        island_config icfg = {3, 2, 2, migration_topology::Random};
+        island_model model(lib, table, 3.0, cfg, icfg);
+        model.run(6);
+
+        Assert::AreEqual(3, model.num_islands());
+        for (int i = 0; i < model.num_islands(); i++) {
+            const auto& curve = model.get_curve(i);
+            Assert::AreEqual(6, (int)curve.size());
+            for (size_t k = 1; k < curve.size(); k++) {
+                //  the elite is kept, so the islands never get worse
+                Assert::IsTrue(curve[k].score >= curve[k - 1].score);
+                Assert::IsTrue(curve[k].ms >= curve[k - 1].ms);
+            }
+            const population& pop = model.get_population(i);
+            Assert::AreEqual(curve.back().score, pop.best_score());
+            Assert::AreEqual(pop.best_score(), shape::score(variations, pop.layout(0)));
+        }
+    }
+
+    TEST_METHOD(test_island_stagnation) {
+        shape sh;
+        shape::parse(std::stringstream(SHAPE4), sh);
+        shape::variation_array variations(6, sh.get_variations());
+        pair_table table(variations, 4);
+        shape_library lib(variations);
+
+        ga_config cfg = {20, 1, 0.9, 8, 2, 4, 4, 12345};
+        island_config icfg = {3, 2, 2, migration_topology::Ring};
+        island_model model(lib, table, 3.0, cfg, icfg);
+        run_controller ctl({1000, 0, 3});
+        model.run(1000, &ctl);
+
+        //  each island stops once its best score did not improve over the last 3 iterations
+        Assert::IsTrue(ctl.get_reason() == stop_reason::Stagnation);
+        for (int i = 0; i < model.num_islands(); i++) {
+            const auto& curve = model.get_curve(i);
+            Assert::IsTrue(curve.size() >= 4 && curve.size() < 1000);
+            Assert::AreEqual(curve[curve.size() - 4].score, curve.back().score);
+            Assert::IsTrue(curve.size() == 4 || curve[curve.size() - 4].score > curve[curve.size() - 5].score);
+        }
+    }
+
 };
 
-}
\ No newline at end of file
+}